@@ -170,7 +170,7 @@ class MainWindow(QMainWindow):
             self, 
             "Open File", 
             "", 
-            "VTK Files (*.vtk);;STL Files (*.stl)", 
+            "VTK Files (*.vtk *.vti);;STL Files (*.stl)", 
             options=options
         )
         if file_path:
@@ -0,0 +1,241 @@
+#include "stlReader.h"
+#include "stl2vox.h"
+#include "voxWriter.h"
+#include "voxHash.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef STL2VOX_MODEL_DIR
+#define STL2VOX_MODEL_DIR "model"
+#endif
+
+// Times each stage of the conversion on the sample models:
+//   read     stlReader::ReadStlFile          triangles/s
+//   surface  stl2vox::SurfaceStage           triangles/s and voxels/s
+//   outside  stl2vox::OutsideStage           voxels/s
+//   write    voxWriter (binary VTK)          voxels/s
+// and prints a hash of every grid so that results can be checked against a
+// reference file written by an earlier run. The reference hashes are for the
+// default flood fill; --fill parity times the ray parity vote instead.
+// --precision double,float times the surface stage with both scalar types
+// (see TriBoxTest::RowMask); float grids are not checked against the
+// reference but are compared with the double grid of the same run.
+
+struct benchConfig
+{
+    std::string modelDir = STL2VOX_MODEL_DIR;
+    std::vector<std::string> models = {"bunny", "dragon", "armadillo", "cat", "teapot"};
+    std::vector<int> resolutions = {64, 128, 256};
+    std::vector<int> threads;
+    int repeat = 3;
+    std::string reference;
+    std::string writeReference;
+    std::string outputFile = "stl2vox_bench_output.vtk";
+    FillMode fill = FillMode::Flood;
+    std::vector<Precision> precisions = {Precision::Double};
+};
+
+static std::vector<std::string> splitList(const std::string &text)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static std::vector<int> splitInts(const std::string &text)
+{
+    std::vector<int> values;
+    for (const auto &item : splitList(text)) values.push_back(std::atoi(item.c_str()));
+    return values;
+}
+
+static void setThreads(int n)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(n);
+#else
+    (void)n;
+#endif
+}
+
+// Best of `repeat` runs, in seconds. setup() runs untimed before each run.
+template<typename Setup, typename Body>
+static double timeBest(int repeat, Setup &&setup, Body &&body)
+{
+    double best = 1e300;
+    for (int r = 0; r < repeat; ++r) {
+        setup();
+        auto t0 = std::chrono::steady_clock::now();
+        body();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+static std::string hex(uint64_t value)
+{
+    std::ostringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << value;
+    return ss.str();
+}
+
+int main(int argc, char** argv)
+{
+    benchConfig config;
+#ifdef _OPENMP
+    config.threads = {omp_get_max_threads()};
+#else
+    config.threads = {1};
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc && arg != "-h" && arg != "--help") {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        if (arg == "--models") config.models = splitList(argv[++i]);
+        else if (arg == "--model-dir") config.modelDir = argv[++i];
+        else if (arg == "--res") config.resolutions = splitInts(argv[++i]);
+        else if (arg == "--threads") config.threads = splitInts(argv[++i]);
+        else if (arg == "--repeat") config.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--reference") config.reference = argv[++i];
+        else if (arg == "--write-reference") config.writeReference = argv[++i];
+        else if (arg == "--output") config.outputFile = argv[++i];
+        else if (arg == "--fill") config.fill = std::string(argv[++i]) == "parity" ? FillMode::Parity : FillMode::Flood;
+        else if (arg == "--precision") {
+            config.precisions.clear();
+            for (const auto &name : splitList(argv[++i])) config.precisions.push_back(voxOptions::ParsePrecision(name));
+        }
+        else {
+            std::cout << "Usage: " << argv[0] << " [--models a,b] [--model-dir DIR] [--res 64,128] [--threads 1,4]"
+                      << " [--repeat N] [--reference FILE] [--write-reference FILE] [--output FILE]"
+                      << " [--fill flood|parity] [--precision double,float]" << std::endl;
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // "model resolution" -> hash
+    std::map<std::string, std::string> expected, measured;
+    if (!config.reference.empty()) {
+        std::ifstream file(config.reference);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open reference file: " << config.reference << std::endl;
+            return 1;
+        }
+        std::string model, hash;
+        int res;
+        while (file >> model >> res >> hash) expected[model + " " + std::to_string(res)] = hash;
+    }
+
+    voxOptions options;
+    options.verbose = false;
+    options.fill = config.fill;
+    int mismatches = 0;
+
+    std::cout << std::left << std::setw(10) << "model" << std::setw(6) << "res" << std::setw(8) << "threads"
+              << std::setw(8) << "prec" << std::setw(9) << "stage" << std::right << std::setw(11) << "seconds" << std::setw(16) << "tri/s"
+              << std::setw(16) << "voxel/s" << "  hash" << std::endl;
+
+    for (const auto &model : config.models) {
+        const std::string path = config.modelDir + "/" + model + ".stl";
+        for (int threads : config.threads) {
+            setThreads(threads);
+
+            STLMesh mesh;
+            double readTime = timeBest(config.repeat, [&] { mesh = STLMesh(); },
+                                       [&] { stlReader::ReadStlFile(path, mesh, false); });
+            const double tris = (double)mesh.triangleList.size();
+
+            auto row = [&](int res, const char *prec, const char *stage, double seconds, double triRate, double voxRate,
+                           const std::string &hash) {
+                std::cout << std::left << std::setw(10) << model << std::setw(6) << res << std::setw(8) << threads
+                          << std::setw(8) << prec << std::setw(9) << stage << std::right << std::fixed << std::setprecision(5)
+                          << std::setw(11) << seconds << std::scientific << std::setprecision(3)
+                          << std::setw(16) << triRate << std::setw(16) << voxRate << "  " << hash
+                          << std::defaultfloat << std::endl;
+            };
+            row(0, "", "read", readTime, tris / readTime, 0, "");
+
+            for (int res : config.resolutions) {
+                options.dim[0] = options.dim[1] = options.dim[2] = res;
+                const double voxels = (double)res * res * res;
+
+                std::vector<uint64_t> doubleSurface;
+
+                for (Precision precision : config.precisions) {
+                    const bool isDouble = precision == Precision::Double;
+                    const char *prec = isDouble ? "double" : "float";
+                    options.precision = precision;
+
+                    voxGrid grid;
+                    double surfaceTime = timeBest(config.repeat, [&] { stl2vox::PrepareGrid(mesh, grid, options); },
+                                                  [&] { stl2vox::SurfaceStage(mesh, grid, options); });
+
+                    // The outside stage needs a fresh copy of the surface plane every run.
+                    std::vector<uint64_t> surface(grid.surface.begin(), grid.surface.end());
+                    double outsideTime = timeBest(config.repeat,
+                        [&] {
+                            stl2vox::PrepareGrid(mesh, grid, options);
+                            std::copy(surface.begin(), surface.end(), grid.surface.begin());
+                        },
+                        [&] { stl2vox::OutsideStage(mesh, grid, options); });
+
+                    double writeTime = timeBest(config.repeat, [] {},
+                                                [&] { voxWriter::WriteFile(config.outputFile, grid, voxFormat::VTKBinary); });
+                    std::remove(config.outputFile.c_str());
+
+                    const std::string hash = hex(voxHash::Grid(grid));
+                    std::string status = hash;
+                    if (isDouble) {
+                        const std::string key = model + " " + std::to_string(res);
+                        measured[key] = hash;
+                        auto it = expected.find(key);
+                        if (it != expected.end() && it->second != hash) {
+                            status += "  MISMATCH (expected " + it->second + ")";
+                            ++mismatches;
+                        }
+                        doubleSurface = surface;
+                    } else if (doubleSurface.size() == surface.size()) {
+                        size_t differ = 0;
+                        for (size_t w = 0; w < surface.size(); ++w) differ += __builtin_popcountll(surface[w] ^ doubleSurface[w]);
+                        status += "  (" + std::to_string(differ) + " surface voxels differ from double)";
+                    }
+
+                    row(res, prec, "surface", surfaceTime, tris / surfaceTime, voxels / surfaceTime, "");
+                    row(res, prec, "outside", outsideTime, 0, voxels / outsideTime, "");
+                    row(res, prec, "write", writeTime, 0, voxels / writeTime, status);
+                }
+            }
+        }
+    }
+
+    if (!config.writeReference.empty()) {
+        std::ofstream file(config.writeReference);
+        for (const auto &entry : measured) file << entry.first << " " << entry.second << "\n";
+    }
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " grid hash mismatch(es) against " << config.reference << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+"""ctypes binding of the stl2vox shared library (stl2vox/stl2vox_c.h).
+
+Meshes are passed as any contiguous buffer (numpy arrays, array.array,
+bytearray, bytes): vertices as float32 or float64 x, y, z triples and
+indices as uint32 triples. Writable buffers are handed to the library
+without a copy. Results are borrowed memoryviews over the grid, so
+numpy.asarray(grid.labels()) does not copy either.
+
+    import numpy as np, stl2vox
+    grid = stl2vox.voxelize_mesh(vertices, faces, dim=(256, 256, 256))
+    labels = np.asarray(grid.labels())   # int8, shape (z, y, x)
+
+The library is looked up in $STL2VOX_LIBRARY, next to this file, in
+../build and ../_build, then on the system library path.
+"""
+
+import ctypes
+import ctypes.util
+import os
+
+__all__ = ["Error", "Grid", "voxelize_mesh", "voxelize_stl"]
+
+FILL = {"flood": 0, "parity": 1}
+RASTER = {"slabs": 0, "triangles": 1}
+PRECISION = {"double": 0, "float": 1}
+
+
+class Error(RuntimeError):
+    pass
+
+
+class _Params(ctypes.Structure):
+    _fields_ = [("dim", ctypes.c_int * 3), ("fill", ctypes.c_int), ("raster", ctypes.c_int),
+                ("sdf_band", ctypes.c_int), ("threads", ctypes.c_int), ("precision", ctypes.c_int),
+                ("morph", ctypes.c_char_p)]
+
+
+class _GridInfo(ctypes.Structure):
+    _fields_ = [("dim", ctypes.c_int * 3), ("origin", ctypes.c_double * 3), ("spacing", ctypes.c_double * 3),
+                ("words_per_row", ctypes.c_size_t), ("has_distance", ctypes.c_int)]
+
+
+def _load():
+    names = ["libstl2vox.so", "libstl2vox.dylib", "stl2vox.dll"]
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [os.environ.get("STL2VOX_LIBRARY")]
+    for directory in (here, os.path.join(here, "..", "build"), os.path.join(here, "..", "_build")):
+        candidates += [os.path.join(directory, name) for name in names]
+    candidates.append(ctypes.util.find_library("stl2vox"))
+    for path in candidates:
+        if path and (os.path.exists(path) or not os.path.dirname(path)):
+            try:
+                return ctypes.CDLL(path)
+            except OSError:
+                pass
+    raise Error("libstl2vox not found, set STL2VOX_LIBRARY")
+
+
+_lib = _load()
+_handle = ctypes.c_void_p
+_lib.stl2vox_voxelize_mesh_f32.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t,
+                                           ctypes.POINTER(_Params), ctypes.POINTER(_handle)]
+_lib.stl2vox_voxelize_mesh_f64.argtypes = _lib.stl2vox_voxelize_mesh_f32.argtypes
+_lib.stl2vox_voxelize_stl.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(_Params),
+                                      ctypes.POINTER(_handle)]
+_lib.stl2vox_grid_morph.argtypes = [_handle, ctypes.c_char_p, ctypes.POINTER(_handle)]
+_lib.stl2vox_grid_free.argtypes = [_handle]
+_lib.stl2vox_grid_get_info.argtypes = [_handle, ctypes.POINTER(_GridInfo)]
+_lib.stl2vox_grid_copy_labels.argtypes = [_handle, ctypes.c_void_p, ctypes.c_size_t]
+for _name in ("labels", "surface_bits", "outside_bits", "distance"):
+    getattr(_lib, "stl2vox_grid_" + _name).argtypes = [_handle]
+    getattr(_lib, "stl2vox_grid_" + _name).restype = ctypes.c_void_p
+_lib.stl2vox_last_error.restype = ctypes.c_char_p
+
+
+def _check(status):
+    if status != 0:
+        raise Error(_lib.stl2vox_last_error().decode())
+
+
+def _pointer(buffer, formats, what):
+    """Address of a contiguous buffer, and an object keeping it alive."""
+    view = memoryview(buffer)
+    if not view.c_contiguous or (formats and (view.format not in formats[0] or view.itemsize != formats[1])):
+        raise Error("%s must be a contiguous buffer of %s" % (what, formats[2] if formats else "bytes"))
+    view = view.cast("B")
+    if view.nbytes == 0:
+        return None, view, 0
+    if view.readonly:
+        data = (ctypes.c_char * view.nbytes).from_buffer_copy(view)
+    else:
+        data = (ctypes.c_char * view.nbytes).from_buffer(view)
+    return ctypes.addressof(data), data, view.nbytes
+
+
+def _params(dim, fill, raster, sdf_band, threads, precision, morph):
+    params = _Params()
+    params.dim[:] = [int(d) for d in dim]
+    params.fill = FILL[fill]
+    params.raster = RASTER[raster]
+    params.sdf_band = int(sdf_band)
+    params.threads = int(threads)
+    params.precision = PRECISION[precision]
+    params.morph = morph.encode() if morph else None
+    return params
+
+
+class Grid:
+    """A voxelized grid. The views it returns keep it alive."""
+
+    def __init__(self, handle):
+        self._handle = handle
+        info = _GridInfo()
+        _lib.stl2vox_grid_get_info(handle, ctypes.byref(info))
+        self.dim = tuple(info.dim)
+        self.origin = tuple(info.origin)
+        self.spacing = tuple(info.spacing)
+        self.words_per_row = info.words_per_row
+        self.has_distance = bool(info.has_distance)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.stl2vox_grid_free(self._handle)
+            self._handle = None
+
+    def _view(self, address, ctype, code, shape):
+        count = shape[0] * shape[1] * shape[2]
+        array = (ctype * count).from_address(address)
+        array._grid = self
+        return memoryview(array).cast("B").cast(code, shape)
+
+    def labels(self):
+        """int8 labels (-1 outside, 0 surface, 1 inside), shape (z, y, x)."""
+        address = _lib.stl2vox_grid_labels(self._handle)
+        if not address:
+            raise Error(_lib.stl2vox_last_error().decode())
+        return self._view(address, ctypes.c_int8, "b", self.dim[::-1])
+
+    def copy_labels(self, out):
+        """Writes the labels into a writable buffer of at least dim[0]*dim[1]*dim[2] bytes."""
+        view = memoryview(out).cast("B")
+        if view.readonly:
+            raise Error("The label buffer must be writable")
+        data = (ctypes.c_char * view.nbytes).from_buffer(view)
+        _check(_lib.stl2vox_grid_copy_labels(self._handle, data, view.nbytes))
+
+    def distance(self):
+        """float32 signed distances, shape (z, y, x), or None without sdf_band."""
+        address = _lib.stl2vox_grid_distance(self._handle)
+        if not address:
+            return None
+        return self._view(address, ctypes.c_float, "f", self.dim[::-1])
+
+    def morph(self, steps):
+        """A new grid with morphology steps applied, e.g. "close:2:sphere,shell:3" (see --morph).
+        Dilations are clipped at the grid boundary; pass morph= when voxelizing to widen the grid."""
+        handle = _handle()
+        _check(_lib.stl2vox_grid_morph(self._handle, steps.encode(), ctypes.byref(handle)))
+        return Grid(handle)
+
+    def bits(self):
+        """The surface and outside bit planes as uint64, shape (z, y, words_per_row)."""
+        shape = (self.dim[2], self.dim[1], self.words_per_row)
+        return (self._view(_lib.stl2vox_grid_surface_bits(self._handle), ctypes.c_uint64, "Q", shape),
+                self._view(_lib.stl2vox_grid_outside_bits(self._handle), ctypes.c_uint64, "Q", shape))
+
+
+def voxelize_mesh(vertices, indices, dim, fill="flood", raster="slabs", sdf_band=0, threads=0, precision="double",
+                  morph=None):
+    """Voxelizes triangles given as uint32 vertex index triples."""
+    view = memoryview(vertices)
+    double = view.format == "d"
+    address, keep, size = _pointer(vertices, ("d" if double else "f", 8 if double else 4, "float32 or float64"),
+                                   "vertices")
+    index_address, index_keep, index_size = _pointer(indices, ("IL", 4, "uint32"), "indices")
+    function = _lib.stl2vox_voxelize_mesh_f64 if double else _lib.stl2vox_voxelize_mesh_f32
+    handle = _handle()
+    params = _params(dim, fill, raster, sdf_band, threads, precision, morph)
+    _check(function(address, size // (24 if double else 12), index_address, index_size // 12,
+                    ctypes.byref(params), ctypes.byref(handle)))
+    return Grid(handle)
+
+
+def voxelize_stl(data, dim, fill="flood", raster="slabs", sdf_band=0, threads=0, precision="double", morph=None):
+    """Voxelizes the bytes of a binary or ASCII STL file."""
+    address, keep, size = _pointer(data, None, "data")
+    handle = _handle()
+    params = _params(dim, fill, raster, sdf_band, threads, precision, morph)
+    _check(_lib.stl2vox_voxelize_stl(address, size, ctypes.byref(params), ctypes.byref(handle)))
+    return Grid(handle)
@@ -0,0 +1,272 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __INDEXEDMESH_H__
+#define __INDEXEDMESH_H__
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stlMesh.h"
+
+// Compact triangle mesh: welded float32 vertices as structure of arrays, three
+// 32-bit indices per triangle and a float32 bounding box per triangle. It has
+// the same accessors as STLMesh (size, triangle, bounds), so the voxelizer
+// accepts either.
+struct IndexedMesh
+{
+    std::vector<float> x, y, z;             // vertex positions
+    std::vector<uint32_t> indices;          // vertices of triangle t are indices[3t .. 3t+2]
+    std::vector<float> boxLo[3], boxHi[3];  // per-triangle bounds, one array per axis
+
+    size_t size() const { return indices.size() / 3; }
+    size_t numVertices() const { return x.size(); }
+
+    Triangle triangle(size_t t) const {
+        Triangle tri;
+        Vector3d *v[3] = { &tri.v0, &tri.v1, &tri.v2 };
+        for(int c = 0; c < 3; ++c){
+            const uint32_t i = indices[3 * t + c];
+            *v[c] = Vector3d(x[i], y[i], z[i]);
+        }
+        return tri;
+    }
+
+    void bounds(size_t t, double lo[3], double hi[3]) const {
+        for(int k = 0; k < 3; ++k){
+            lo[k] = boxLo[k][t];
+            hi[k] = boxHi[k][t];
+        }
+    }
+
+    size_t memoryBytes() const {
+        return 3 * x.size() * sizeof(float) + indices.size() * sizeof(uint32_t) + 6 * size() * sizeof(float);
+    }
+
+    void computeBounds(){
+        const long long numTriangles = (long long)size();
+        const std::vector<float> *coord[3] = { &x, &y, &z };
+        for(int k = 0; k < 3; ++k){
+            boxLo[k].resize(numTriangles);
+            boxHi[k].resize(numTriangles);
+        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long t = 0; t < numTriangles; ++t){
+            const uint32_t *tri = &indices[3 * t];
+            for(int k = 0; k < 3; ++k){
+                const std::vector<float> &c = *coord[k];
+                boxLo[k][t] = std::min(c[tri[0]], std::min(c[tri[1]], c[tri[2]]));
+                boxHi[k][t] = std::max(c[tri[0]], std::max(c[tri[1]], c[tri[2]]));
+            }
+        }
+    }
+};
+
+// Builds an IndexedMesh from unindexed triangle corners, merging corners whose
+// coordinates are bit-identical (-0 and +0 count as equal). Corners are hashed
+// into partitions with a parallel counting sort, and each partition is
+// deduplicated by its own thread with an open-addressing table. Every vertex
+// keeps the position of its first corner in input order, so the result does
+// not depend on the thread count.
+class meshWelder
+{
+private:
+    static const int partitionBits = 8;
+
+    static uint64_t Hash(const uint32_t key[3]){
+        uint64_t h = (uint64_t)key[0] * 0x9E3779B97F4A7C15ULL;
+        h ^= ((uint64_t)key[1] + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+        h ^= ((uint64_t)key[2] + 0x85EBCA77C2B2AE63ULL) * 0x165667B19E3779F9ULL;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static int MaxThreads(){
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+public:
+    // corner(t, c, p) stores corner c (0..2) of triangle t in p[0..2].
+    template<typename Corner>
+    static void Weld(size_t numTriangles, Corner &&corner, IndexedMesh &mesh){
+        const size_t numCorners = 3 * numTriangles;
+        if(numCorners > UINT32_MAX){
+            throw std::runtime_error("Too many triangles for 32-bit indices");
+        }
+        const long long n = (long long)numCorners;
+        const int numPartitions = 1 << partitionBits;
+
+        // Coordinates as bit patterns, and their hashes.
+        std::vector<uint32_t> keys(3 * numCorners);
+        std::vector<uint64_t> hashes(numCorners);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long t = 0; t < (long long)numTriangles; ++t){
+            for(int c = 0; c < 3; ++c){
+                float p[3];
+                corner((size_t)t, c, p);
+                const size_t i = 3 * (size_t)t + c;
+                for(int k = 0; k < 3; ++k){
+                    const float v = p[k] + 0.0f;
+                    std::memcpy(&keys[3 * i + k], &v, sizeof(float));
+                }
+                hashes[i] = Hash(&keys[3 * i]);
+            }
+        }
+
+        // Stable counting sort of corner ids by partition.
+        const int numChunks = std::max(1, 4 * MaxThreads());
+        const long long chunkSize = (n + numChunks - 1) / numChunks;
+        std::vector<size_t> counts((size_t)numChunks * numPartitions, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(int chunk = 0; chunk < numChunks; ++chunk){
+            const long long end = std::min(n, (chunk + 1) * chunkSize);
+            for(long long i = chunk * chunkSize; i < end; ++i){
+                ++counts[(size_t)chunk * numPartitions + (hashes[i] >> (64 - partitionBits))];
+            }
+        }
+        std::vector<size_t> partitionStart(numPartitions + 1, 0);
+        size_t offset = 0;
+        for(int p = 0; p < numPartitions; ++p){
+            partitionStart[p] = offset;
+            for(int chunk = 0; chunk < numChunks; ++chunk){
+                size_t &count = counts[(size_t)chunk * numPartitions + p];
+                const size_t start = offset;
+                offset += count;
+                count = start;
+            }
+        }
+        partitionStart[numPartitions] = offset;
+
+        std::vector<uint32_t> order(numCorners);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(int chunk = 0; chunk < numChunks; ++chunk){
+            const long long end = std::min(n, (chunk + 1) * chunkSize);
+            for(long long i = chunk * chunkSize; i < end; ++i){
+                order[counts[(size_t)chunk * numPartitions + (hashes[i] >> (64 - partitionBits))]++] = (uint32_t)i;
+            }
+        }
+
+        // rep[i]: first corner with the same coordinates as corner i.
+        std::vector<uint32_t> rep(numCorners);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            std::vector<uint32_t> table;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+            for(int p = 0; p < numPartitions; ++p){
+                const size_t begin = partitionStart[p], end = partitionStart[p + 1];
+                size_t tableSize = 16;
+                while(tableSize < 2 * (end - begin)) tableSize *= 2;
+                table.assign(tableSize, UINT32_MAX);
+                for(size_t j = begin; j < end; ++j){
+                    const uint32_t i = order[j];
+                    size_t slot = hashes[i] & (tableSize - 1);
+                    while(true){
+                        const uint32_t other = table[slot];
+                        if(other == UINT32_MAX){
+                            table[slot] = i;
+                            rep[i] = i;
+                            break;
+                        }
+                        if(hashes[other] == hashes[i] && std::memcmp(&keys[3 * (size_t)other], &keys[3 * (size_t)i], 3 * sizeof(uint32_t)) == 0){
+                            rep[i] = other;
+                            break;
+                        }
+                        slot = (slot + 1) & (tableSize - 1);
+                    }
+                }
+            }
+        }
+
+        // Number the first corners in input order and point every corner at them.
+        std::vector<size_t> chunkVertices(numChunks + 1, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(int chunk = 0; chunk < numChunks; ++chunk){
+            const long long end = std::min(n, (chunk + 1) * chunkSize);
+            size_t count = 0;
+            for(long long i = chunk * chunkSize; i < end; ++i) count += rep[i] == (uint32_t)i;
+            chunkVertices[chunk + 1] = count;
+        }
+        for(int chunk = 0; chunk < numChunks; ++chunk) chunkVertices[chunk + 1] += chunkVertices[chunk];
+
+        const size_t numVertices = chunkVertices[numChunks];
+        mesh.x.resize(numVertices);
+        mesh.y.resize(numVertices);
+        mesh.z.resize(numVertices);
+        mesh.indices.resize(numCorners);
+        std::vector<uint32_t> &vertexId = order;   // reused: vertex id of each first corner
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(int chunk = 0; chunk < numChunks; ++chunk){
+            const long long end = std::min(n, (chunk + 1) * chunkSize);
+            size_t v = chunkVertices[chunk];
+            for(long long i = chunk * chunkSize; i < end; ++i){
+                if(rep[i] != (uint32_t)i) continue;
+                vertexId[i] = (uint32_t)v;
+                std::memcpy(&mesh.x[v], &keys[3 * i + 0], sizeof(float));
+                std::memcpy(&mesh.y[v], &keys[3 * i + 1], sizeof(float));
+                std::memcpy(&mesh.z[v], &keys[3 * i + 2], sizeof(float));
+                ++v;
+            }
+        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long i = 0; i < n; ++i) mesh.indices[i] = vertexId[rep[i]];
+
+        mesh.computeBounds();
+    }
+};
+
+#endif
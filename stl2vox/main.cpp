@@ -1,31 +1,326 @@
 #include "stlReader.h"
 #include "stl2vox.h"
 #include "voxWriter.h"
+#include "voxBatch.h"
+#include "voxServer.h"
 
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <string>
+#include <vector>
 
-std::string replaceExtension(const std::string& path, const std::string& newExt) {
-    size_t slashPos = path.find_last_of("/\\");
-    size_t dotPos = path.find_last_of('.');
-    if (dotPos == std::string::npos || (slashPos != std::string::npos && dotPos < slashPos)) {
-        return path + newExt;
+static void printUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " [options] <stl file>..." << std::endl;
+    std::cout << "       " << program << " [options] --serve SOCKET" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --dim X Y Z           number of voxels in X, Y, Z (asked on stdin when omitted)" << std::endl;
+    std::cout << "  --voxel-size H        cubic voxels of edge H in mesh units instead of --dim" << std::endl;
+    std::cout << "  --max-memory MIB      refuse grids estimated to need more; alone, use the finest cubic grid that fits" << std::endl;
+    std::cout << "  --downgrade           coarsen grids over --max-memory until they fit instead of refusing them" << std::endl;
+    std::cout << "  --estimate            print the grid and its memory and time estimate without converting" << std::endl;
+    std::cout << "  --format FORMAT       vtk (binary, default), vtk-ascii, vti, vti-zlib or rle (run-length coded .vrle)" << std::endl;
+    std::cout << "  --output-dir DIR      write results into DIR (created if missing) instead of next to the inputs" << std::endl;
+    std::cout << "  --manifest FILE       read more STL paths from FILE, one per line" << std::endl;
+    std::cout << "  --jobs N              voxelize up to N files at once in batch mode, or N requests with --serve" << std::endl;
+    std::cout << "  --raster MODE         slabs (default) or triangles" << std::endl;
+    std::cout << "  --fill MODE           flood (default) or parity, a per-voxel X/Y/Z ray vote that tolerates holes" << std::endl;
+    std::cout << "  --precision TYPE      double (default) or float for the per-voxel triangle tests" << std::endl;
+    std::cout << "  --sparse              use the sparse brick grid" << std::endl;
+    std::cout << "  --sdf BAND            also write signed distances (float32), exact within BAND voxels of the surface" << std::endl;
+    std::cout << "  --indexed             load a compact welded float32 mesh (ASCII coordinates are rounded to float)" << std::endl;
+    std::cout << "  --morph STEPS         apply OP:RADIUS[:ELEMENT] steps to the grid, e.g. close:2:sphere,shell:3" << std::endl;
+    std::cout << "                        (OP dilate, erode, open, close or shell; ELEMENT 6 (default), 18, 26 or sphere)" << std::endl;
+    std::cout << "  --components          also write the IDs of solid bodies and enclosed cavities (part_components)" << std::endl;
+    std::cout << "                        and a table of their volumes and bounding boxes (part_components.csv)" << std::endl;
+    std::cout << "  --levels N            also write N-1 coarser levels (part_L1, part_L2, ...), each half the resolution" << std::endl;
+    std::cout << "  --cache DIR           reuse grids from an on-disk cache shared by runs and processes" << std::endl;
+    std::cout << "  --cache-size MIB      size limit of the cache, least recently used entries go first (default 4096)" << std::endl;
+    std::cout << "  --stream              write the grid slab by slab without holding it in memory" << std::endl;
+    std::cout << "  --stream-depth N      Z layers per streamed slab (default: about 256 MiB per slab)" << std::endl;
+    std::cout << "  --quiet               only report errors and per-file results" << std::endl;
+    std::cout << "  --assembly LIST       voxelize the parts listed as 'MATERIAL PATH' lines into one material grid" << std::endl;
+    std::cout << "  --overlap RULE        part that gets voxels several parts claim: last (default), first, max or min material" << std::endl;
+    std::cout << "  --unpack FILE         convert a .vrle file to --format instead of voxelizing" << std::endl;
+    std::cout << "  --box X0 Y0 Z0 X1 Y1 Z1  with --unpack, only decode voxels X0 <= x < X1 etc." << std::endl;
+    std::cout << "  --serve SOCKET        run as a resident service on a Unix domain socket (see voxServer.h)" << std::endl;
+    std::cout << "  --queue N             requests waiting for a free job before BUSY replies (default 16)" << std::endl;
+    std::cout << "  --mesh-cache MIB      parsed meshes kept in memory by the service (default 1024)" << std::endl;
+    std::cout << "  --connect SOCKET      convert the inputs on a running service instead" << std::endl;
+    std::cout << "  --stats FILE          write per-stage timings and counters to FILE" << std::endl;
+    std::cout << "                        (JSON lines for *.json or '-', CSV otherwise)" << std::endl;
+}
+
+static int toPositiveInt(const std::string &option, const char *text)
+{
+    char *end = nullptr;
+    long value = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value <= 0 || value > 1 << 30) {
+        throw std::runtime_error("Invalid value for " + option + ": " + text);
+    }
+    return (int)value;
+}
+
+static int toNonNegativeInt(const std::string &option, const char *text)
+{
+    char *end = nullptr;
+    long value = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0 || value > 1 << 30) {
+        throw std::runtime_error("Invalid value for " + option + ": " + text);
+    }
+    return (int)value;
+}
+
+static double toPositiveDouble(const std::string &option, const char *text)
+{
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(value > 0) || !std::isfinite(value)) {
+        throw std::runtime_error("Invalid value for " + option + ": " + text);
+    }
+    return value;
+}
+
+// JSON (one object per line) when path ends in .json or is "-" (stdout), CSV otherwise.
+static void writeStats(const std::string &path, const std::vector<voxStats> &stats)
+{
+    bool json = path == "-" || (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0);
+    std::ofstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file.is_open()) throw std::runtime_error("Failed to open file: " + path);
+    }
+    std::ostream &out = path == "-" ? std::cout : file;
+    if (!json) out << voxStats::csvHeader() << "\n";
+    for (const voxStats &entry : stats) out << (json ? entry.toJson() : entry.toCsv()) << "\n";
+}
+
+static voxServer *activeServer = nullptr;
+
+static void stopServer(int)
+{
+    if (activeServer) activeServer->stop();
+}
+
+// Sends one CONVERT request per input to a running service.
+static int convertRemote(const std::string &socketPath, const std::vector<std::string> &inputs, const voxOptions &options)
+{
+    voxBatch::CheckOutputs(inputs, options);
+    voxBatch::MakeOutputDir(options);
+    int failed = 0;
+    for (const std::string &input : inputs) {
+        const std::string output = std::filesystem::absolute(voxBatch::OutputPath(input, options)).string();
+        const std::string reply = voxServer::Request(socketPath,
+            voxServer::ConvertRequest(std::filesystem::absolute(input).string(), output, options));
+        std::cout << input << ": " << reply << std::endl;
+        if (reply.compare(0, 3, "OK ") != 0) ++failed;
     }
-    return path.substr(0, dotPos) + newExt;
+    return failed == 0 ? 0 : 2;
 }
 
 int main(int argc, char** argv)
 {
-    if(argc < 2){
-        std::cout << "Usage: " << argv[0] << " <stl file>" << std::endl;
+    voxOptions options;
+    std::vector<std::string> inputs;
+    std::string statsPath;
+    std::string serveSocket, connectSocket, unpackPath, assemblyPath;
+    int box[6] = {0, 0, 0, 0, 0, 0};
+    bool hasBox = false;
+    voxServer::Limits limits;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto next = [&](int count = 1) {
+                if (i + count >= argc) throw std::runtime_error("Missing value for " + arg);
+                i += count;
+                return argv[i - count + 1];
+            };
+
+            if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (arg == "--dim") {
+                next(3);
+                for (int k = 0; k < 3; ++k) options.dim[k] = toPositiveInt(arg, argv[i - 2 + k]);
+            } else if (arg == "--voxel-size") {
+                options.voxelSize = toPositiveDouble(arg, next());
+            } else if (arg == "--max-memory") {
+                options.memoryBudget = (uint64_t)toPositiveInt(arg, next()) << 20;
+            } else if (arg == "--downgrade") {
+                options.downgrade = true;
+            } else if (arg == "--estimate") {
+                options.estimateOnly = true;
+            } else if (arg == "--format") {
+                options.format = voxOptions::ParseFormat(next());
+            } else if (arg == "--output-dir") {
+                options.outputDir = next();
+            } else if (arg == "--manifest") {
+                auto listed = voxBatch::ReadManifest(next());
+                inputs.insert(inputs.end(), listed.begin(), listed.end());
+            } else if (arg == "--jobs") {
+                options.jobs = toPositiveInt(arg, next());
+            } else if (arg == "--raster") {
+                options.raster = voxOptions::ParseRaster(next());
+            } else if (arg == "--fill") {
+                options.fill = voxOptions::ParseFill(next());
+            } else if (arg == "--precision") {
+                options.precision = voxOptions::ParsePrecision(next());
+            } else if (arg == "--sparse") {
+                options.sparse = true;
+            } else if (arg == "--sdf") {
+                options.sdfBand = toPositiveInt(arg, next());
+            } else if (arg == "--indexed") {
+                options.indexed = true;
+            } else if (arg == "--components") {
+                options.components = true;
+            } else if (arg == "--morph") {
+                options.morph = voxOptions::ParseMorph(next());
+            } else if (arg == "--levels") {
+                options.levels = toPositiveInt(arg, next());
+                if (options.levels > 16) throw std::runtime_error("At most 16 levels are supported");
+            } else if (arg == "--cache") {
+                options.cacheDir = next();
+            } else if (arg == "--cache-size") {
+                options.cacheBytes = (uint64_t)toPositiveInt(arg, next()) << 20;
+            } else if (arg == "--stream") {
+                options.stream = true;
+            } else if (arg == "--stream-depth") {
+                options.streamDepth = toPositiveInt(arg, next());
+            } else if (arg == "--quiet") {
+                options.verbose = false;
+            } else if (arg == "--assembly") {
+                assemblyPath = next();
+            } else if (arg == "--overlap") {
+                options.overlap = voxOptions::ParseOverlap(next());
+            } else if (arg == "--unpack") {
+                unpackPath = next();
+            } else if (arg == "--box") {
+                next(6);
+                for (int k = 0; k < 6; ++k) box[k] = toNonNegativeInt(arg, argv[i - 5 + k]);
+                hasBox = true;
+            } else if (arg == "--serve") {
+                serveSocket = next();
+            } else if (arg == "--queue") {
+                limits.queue = toNonNegativeInt(arg, next());
+            } else if (arg == "--mesh-cache") {
+                limits.meshCacheBytes = (uint64_t)toPositiveInt(arg, next()) << 20;
+            } else if (arg == "--connect") {
+                connectSocket = next();
+            } else if (arg == "--stats") {
+                statsPath = next();
+            } else if (arg.size() > 1 && arg[0] == '-') {
+                throw std::runtime_error("Unknown option: " + arg);
+            } else {
+                inputs.push_back(arg);
+            }
+        }
+        if (options.voxelSize > 0 && options.dim[0] > 0) {
+            throw std::runtime_error("Give either --dim or --voxel-size");
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!serveSocket.empty()) {
+        try {
+            limits.jobs = options.jobs;
+            voxServer server(serveSocket, options, limits);
+            activeServer = &server;
+            std::signal(SIGINT, stopServer);
+            std::signal(SIGTERM, stopServer);
+            if (options.verbose) std::cout << "Listening on " << serveSocket << std::endl;
+            server.run();
+            activeServer = nullptr;
+            return 0;
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (!unpackPath.empty()) {
+        try {
+            const voxRleReader reader(unpackPath);
+            voxBatch::MakeOutputDir(options);
+            voxGrid grid;
+            if (hasBox) reader.readGrid(grid, box, box + 3);
+            else reader.readGrid(grid);
+            const std::string output = voxBatch::OutputPath(unpackPath, options);
+            if (std::filesystem::exists(output) && std::filesystem::equivalent(output, unpackPath)) {
+                throw std::runtime_error("Unpacking would overwrite " + unpackPath);
+            }
+            voxWriter::WriteFile(output, grid, options.format);
+            if (options.verbose) std::cout << "Wrote " << output << std::endl;
+            return 0;
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (!assemblyPath.empty()) {
+        try {
+            std::vector<voxStats> stats(1);
+            if (!statsPath.empty()) options.stats = &stats[0];
+            voxBatch::ConvertAssembly(assemblyPath, options);
+            if (!statsPath.empty()) writeStats(statsPath, stats);
+            return 0;
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (inputs.empty()) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    STLMesh mesh;
-    stlReader::ReadStlFile(argv[1], mesh);
+    try {
+        // Batch and cached runs need the grid size before any file is read, so
+        // ask for it once up front.
+        if (!connectSocket.empty() && (options.voxelSize > 0 || options.memoryBudget > 0)) {
+            throw std::runtime_error("A running service takes the grid size from --dim only");
+        }
+        if (!connectSocket.empty() && (!options.morph.empty() || options.components)) {
+            throw std::runtime_error("A running service applies its own --morph and --components");
+        }
+        const bool needDim = !connectSocket.empty() || ((inputs.size() > 1 || !options.cacheDir.empty()) &&
+                                                        options.voxelSize == 0 && options.memoryBudget == 0);
+        if (needDim && (options.dim[0] <= 0 || options.dim[1] <= 0 || options.dim[2] <= 0)) {
+            std::cout << "Please Enter the Number of Voxels in X, Y, Z direction: ";
+            std::cin >> options.dim[0] >> options.dim[1] >> options.dim[2];
+            if (!std::cin) throw std::runtime_error("Invalid voxel grid dimension");
+        }
 
-    voxGrid voxel;
-    stl2vox::Convert(mesh, voxel);
+        if (!connectSocket.empty()) return convertRemote(connectSocket, inputs, options);
 
-    std::string outputFile = replaceExtension(argv[1], ".vtk");
-    voxWriter::WriteVTKFile(outputFile, voxel);
-}
\ No newline at end of file
+        if (options.estimateOnly) {
+            size_t over = 0;
+            for (const std::string &input : inputs) over += !voxBatch::EstimateFile(input, options);
+            return over == 0 ? 0 : 2;
+        }
+
+        std::vector<voxStats> stats;
+        if (inputs.size() == 1) {
+            stats.resize(1);
+            if (!statsPath.empty()) options.stats = &stats[0];
+            voxBatch::ConvertFile(inputs[0], options);
+            if (!statsPath.empty()) writeStats(statsPath, stats);
+            return 0;
+        }
+
+        size_t failed = voxBatch::Run(inputs, options, statsPath.empty() ? nullptr : &stats);
+        if (!statsPath.empty()) writeStats(statsPath, stats);
+        return failed == 0 ? 0 : 2;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STL2VOX_HAS_MMAP 1
+#endif
+
+// View of a whole file. Uses mmap where available and falls back to reading
+// the file into memory elsewhere. A copy-on-write view may be modified in
+// memory; the file itself is never changed.
+class mappedFile
+{
+private:
+    char *ptr = nullptr;
+    size_t length = 0;
+    std::vector<char> buffer;
+
+    void Release(){
+#ifdef STL2VOX_HAS_MMAP
+        if(ptr != nullptr && buffer.empty() && length > 0){
+            munmap(ptr, length);
+        }
+#endif
+        ptr = nullptr;
+        length = 0;
+        buffer.clear();
+    }
+
+public:
+    mappedFile() {}
+    explicit mappedFile(const std::string &filename, bool copyOnWrite = false) { Open(filename, copyOnWrite); }
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+    ~mappedFile() { Release(); }
+
+    void Open(const std::string &filename, bool copyOnWrite = false){
+        Release();
+#ifdef STL2VOX_HAS_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0){
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0){
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + filename);
+        }
+        length = (size_t)st.st_size;
+        if(length > 0){
+            void *p = mmap(nullptr, length, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p == MAP_FAILED){
+                ::close(fd);
+                length = 0;
+                throw std::runtime_error("Failed to map file: " + filename);
+            }
+            if(!copyOnWrite) madvise(p, length, MADV_SEQUENTIAL);
+            ptr = static_cast<char*>(p);
+        }
+        ::close(fd);
+#else
+        (void)copyOnWrite;
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if(!file.is_open()){
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+        buffer.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+        ptr = buffer.data();
+        length = buffer.size();
+#endif
+    }
+
+    const char* data() const { return ptr; }
+    char* data() { return ptr; }
+    size_t size() const { return length; }
+};
+
+#endif
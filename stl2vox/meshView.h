@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __MESHVIEW_H__
+#define __MESHVIEW_H__
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "stlMesh.h"
+
+// Triangle mesh over buffers owned by the caller: interleaved x, y, z vertex
+// positions and three vertex indices per triangle. Nothing is copied, so the
+// buffers must outlive the view. It has the same accessors as STLMesh and
+// IndexedMesh, so the voxelizer accepts it directly.
+template<typename Real, typename Index = uint32_t>
+struct meshView
+{
+    const Real *vertices = nullptr;     // vertex i is vertices[3i .. 3i+2]
+    size_t numVertices = 0;
+    const Index *indices = nullptr;     // triangle t is indices[3t .. 3t+2]
+    size_t numTriangles = 0;
+
+    meshView() {}
+    meshView(const Real *vertices, size_t numVertices, const Index *indices, size_t numTriangles)
+        : vertices(vertices), numVertices(numVertices), indices(indices), numTriangles(numTriangles) {}
+
+    size_t size() const { return numTriangles; }
+
+    // The caller's buffers, which stay resident while the view is used.
+    size_t memoryBytes() const { return 3 * numVertices * sizeof(Real) + 3 * numTriangles * sizeof(Index); }
+
+    Triangle triangle(size_t t) const {
+        Triangle tri;
+        Vector3d *v[3] = { &tri.v0, &tri.v1, &tri.v2 };
+        for(int c = 0; c < 3; ++c){
+            const Real *p = vertices + 3 * (size_t)indices[3 * t + c];
+            *v[c] = Vector3d(p[0], p[1], p[2]);
+        }
+        return tri;
+    }
+
+    void bounds(size_t t, double lo[3], double hi[3]) const {
+        const Real *a = vertices + 3 * (size_t)indices[3 * t];
+        const Real *b = vertices + 3 * (size_t)indices[3 * t + 1];
+        const Real *c = vertices + 3 * (size_t)indices[3 * t + 2];
+        for(int k = 0; k < 3; ++k){
+            lo[k] = std::min(a[k], std::min(b[k], c[k]));
+            hi[k] = std::max(a[k], std::max(b[k], c[k]));
+        }
+    }
+
+    // Buffers from outside the program are checked once before use, since
+    // the voxelizer trusts indices and bounds.
+    void check() const {
+        if(numTriangles == 0) throw std::runtime_error("Mesh contains no triangles");
+        if(vertices == nullptr || indices == nullptr) throw std::runtime_error("Missing vertex or index buffer");
+        for(size_t i = 0; i < 3 * numTriangles; ++i){
+            if((size_t)indices[i] >= numVertices){
+                throw std::runtime_error("Vertex index " + std::to_string((unsigned long long)indices[i]) + " out of range");
+            }
+        }
+        for(size_t i = 0; i < 3 * numVertices; ++i){
+            if(!std::isfinite((double)vertices[i])) throw std::runtime_error("Vertex coordinates must be finite");
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RUNLABELS_H__
+#define __RUNLABELS_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Union-find over dense indices. A root is always the smallest index of its
+// set, so roots never depend on the order in which unions happen.
+struct disjointSets
+{
+    std::vector<uint32_t> parent;
+
+    uint32_t add(){
+        parent.push_back((uint32_t)parent.size());
+        return parent.back();
+    }
+
+    uint32_t find(uint32_t i){
+        while(parent[i] != i){
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    void unite(uint32_t a, uint32_t b){
+        a = find(a);
+        b = find(b);
+        if(a == b) return;
+        if(a < b) parent[b] = a;
+        else parent[a] = b;
+    }
+};
+
+// Maximal X runs of the set voxels of a block of bit-plane rows, with one set
+// per run. Two runs are 6-connected when they overlap in X and their rows are
+// neighbours in Y (same layer) or in Z (same Y).
+struct runTable : public disjointSets
+{
+    int dim[3] = {0, 0, 0};         // X, Y and number of Z layers of the block
+    std::vector<size_t> rowStart;   // runs of row (y, z) are [rowBegin(y, z), rowEnd(y, z))
+    std::vector<int> x0, x1;        // inclusive X range of each run
+
+    size_t numRuns() const { return x0.size(); }
+    size_t rowIndex(int y, int z) const { return (size_t)z * dim[1] + y; }
+    size_t rowBegin(int y, int z) const { return rowStart[rowIndex(y, z)]; }
+    size_t rowEnd(int y, int z) const { return rowStart[rowIndex(y, z) + 1]; }
+};
+
+class runLabeling
+{
+private:
+    // First position >= from in [from, numX) whose bit equals `value`, or numX.
+    static int NextBit(const uint64_t *row, int numX, int from, bool value){
+        const int words = (numX + 63) / 64;
+        for(int w = from >> 6; w < words; ++w){
+            uint64_t bits = value ? row[w] : ~row[w];
+            if(w == from >> 6) bits &= ~uint64_t(0) << (from & 63);
+            if(bits) return std::min(numX, w * 64 + __builtin_ctzll(bits));
+        }
+        return numX;
+    }
+
+    template<typename Visit>
+    static void ForEachRun(const uint64_t *row, int numX, Visit &&visit){
+        int x = NextBit(row, numX, 0, true);
+        while(x < numX){
+            const int end = NextBit(row, numX, x, false);
+            visit(x, end - 1);
+            if(end >= numX) break;
+            x = NextBit(row, numX, end, true);
+        }
+    }
+
+    // Unites the overlapping runs of two rows.
+    static void UniteRows(runTable &table, size_t a, size_t aEnd, size_t b, size_t bEnd){
+        while(a < aEnd && b < bEnd){
+            if(table.x1[a] < table.x0[b]) { ++a; continue; }
+            if(table.x1[b] < table.x0[a]) { ++b; continue; }
+            table.unite((uint32_t)a, (uint32_t)b);
+            if(table.x1[a] < table.x1[b]) ++a;
+            else ++b;
+        }
+    }
+
+    static void UniteLayers(runTable &table, int z){
+        for(int y = 0; y < table.dim[1]; ++y){
+            UniteRows(table, table.rowBegin(y, z - 1), table.rowEnd(y, z - 1), table.rowBegin(y, z), table.rowEnd(y, z));
+        }
+    }
+
+public:
+    // Collects the runs of rows(y, z), a pointer to the row's bit words. Bits at
+    // or beyond dimX must be clear. Every run starts as its own component.
+    template<typename Rows>
+    static void Build(runTable &table, int dimX, int dimY, int dimZ, Rows &&rows){
+        table.dim[0] = dimX;
+        table.dim[1] = dimY;
+        table.dim[2] = dimZ;
+        const long long numRows = (long long)dimY * dimZ;
+        table.rowStart.assign(numRows + 1, 0);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long r = 0; r < numRows; ++r){
+            size_t count = 0;
+            ForEachRun(rows((int)(r % dimY), (int)(r / dimY)), dimX, [&](int, int) { ++count; });
+            table.rowStart[r + 1] = count;
+        }
+        for(long long r = 0; r < numRows; ++r) table.rowStart[r + 1] += table.rowStart[r];
+
+        const size_t total = table.rowStart[numRows];
+        if(total > UINT32_MAX) {
+            throw std::runtime_error("Too many runs in one block, use thinner slabs");
+        }
+        table.x0.resize(total);
+        table.x1.resize(total);
+        table.parent.resize(total);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long r = 0; r < numRows; ++r){
+            size_t i = table.rowStart[r];
+            ForEachRun(rows((int)(r % dimY), (int)(r / dimY)), dimX, [&](int a, int b) {
+                table.x0[i] = a;
+                table.x1[i] = b;
+                table.parent[i] = (uint32_t)i;
+                ++i;
+            });
+        }
+    }
+
+    // Joins 6-connected runs and leaves parent[i] pointing at the root of run i.
+    // Layers are joined internally in parallel, then neighbouring groups of
+    // layers are merged pairwise with doubling group sizes; each merge only
+    // touches runs of its own two groups.
+    static void Label(runTable &table){
+        const int numY = table.dim[1];
+        const int numZ = table.dim[2];
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+        for(int z = 0; z < numZ; ++z){
+            for(int y = 1; y < numY; ++y){
+                UniteRows(table, table.rowBegin(y - 1, z), table.rowEnd(y - 1, z), table.rowBegin(y, z), table.rowEnd(y, z));
+            }
+        }
+
+        for(int step = 1; step < numZ; step *= 2){
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+            for(int z = step; z < numZ; z += 2 * step){
+                UniteLayers(table, z);
+            }
+        }
+
+        // Parents always have smaller indices, so one ascending pass flattens the forest.
+        for(size_t i = 0; i < table.numRuns(); ++i){
+            table.parent[i] = table.parent[table.parent[i]];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SPARSEGRID_H__
+#define __SPARSEGRID_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+// 8x8x8 block of voxels. Each plane holds one 64-bit word per Z layer with
+// bit (y * 8 + x); the meaning of the bits is the same as in voxGrid.
+struct voxBrick
+{
+    uint64_t surface[8];
+    uint64_t outside[8];
+};
+
+// Sparse voxel grid: bricks are only allocated where the surface passes, and
+// every other brick cell is a uniform tile that is either outside or inside.
+struct sparseGrid
+{
+    static const int brickBits = 3;
+    static const int brickSize = 1 << brickBits;
+
+    double origin[3] = {0, 0, 0};
+    double spacing[3] = {1, 1, 1};
+    int dim[3] = {0, 0, 0};
+    int numBricks[3] = {0, 0, 0};
+
+    std::unordered_map<uint64_t, uint32_t> brickIndex; // brick cell -> bricks[]
+    std::vector<voxBrick> bricks;
+    std::vector<uint64_t> outsideTiles;                // one bit per brick cell
+
+    ~sparseGrid(){
+        brickIndex.clear();
+        bricks.clear();
+        bricks.shrink_to_fit();
+        outsideTiles.clear();
+        outsideTiles.shrink_to_fit();
+    }
+
+    // Sizes the top level from dim; every cell starts as an inside tile.
+    void allocate(){
+        for(int k = 0; k < 3; ++k){
+            numBricks[k] = (dim[k] + brickSize - 1) >> brickBits;
+        }
+        brickIndex.clear();
+        bricks.clear();
+        outsideTiles.assign((numCells() + 63) / 64, 0);
+    }
+
+    size_t numVoxels() const { return (size_t)dim[0] * dim[1] * dim[2]; }
+    size_t numCells() const { return (size_t)numBricks[0] * numBricks[1] * numBricks[2]; }
+
+    uint64_t cellKey(int bx, int by, int bz) const {
+        return ((uint64_t)bz * numBricks[1] + by) * numBricks[0] + bx;
+    }
+
+    voxBrick* findBrick(uint64_t key){
+        auto it = brickIndex.find(key);
+        return it == brickIndex.end() ? nullptr : &bricks[it->second];
+    }
+    const voxBrick* findBrick(uint64_t key) const {
+        auto it = brickIndex.find(key);
+        return it == brickIndex.end() ? nullptr : &bricks[it->second];
+    }
+
+    voxBrick& addBrick(uint64_t key){
+        auto it = brickIndex.find(key);
+        if(it != brickIndex.end()) return bricks[it->second];
+        brickIndex.emplace(key, (uint32_t)bricks.size());
+        bricks.push_back(voxBrick{});
+        return bricks.back();
+    }
+
+    bool isOutsideTile(uint64_t key) const { return (outsideTiles[key >> 6] >> (key & 63)) & 1; }
+    void setOutsideTile(uint64_t key) { outsideTiles[key >> 6] |= uint64_t(1) << (key & 63); }
+
+    // -1:empty 0:surface 1:inside, as any signed Label type
+    template<typename Label = int>
+    Label get(int x, int y, int z) const {
+        uint64_t key = cellKey(x >> brickBits, y >> brickBits, z >> brickBits);
+        const voxBrick *brick = findBrick(key);
+        if(brick == nullptr) return isOutsideTile(key) ? Label(-1) : Label(1);
+
+        uint64_t bit = uint64_t(1) << (((y & 7) << 3) | (x & 7));
+        if(brick->surface[z & 7] & bit) return Label(0);
+        if(brick->outside[z & 7] & bit) return Label(-1);
+        return Label(1);
+    }
+
+    size_t memoryBytes() const {
+        return bricks.capacity() * sizeof(voxBrick)
+             + brickIndex.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*))
+             + brickIndex.bucket_count() * sizeof(void*)
+             + outsideTiles.capacity() * sizeof(uint64_t);
+    }
+};
+
+#endif
@@ -31,8 +31,11 @@
 #include <cmath>
 #include <iostream>
 #include <vector>
-#include <queue>
 #include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <string>
+#include <sstream>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -40,42 +43,144 @@
 
 #include "stlMesh.h"
 #include "voxGrid.h"
+#include "sparseGrid.h"
+#include "triBoxTest.h"
+#include "voxOptions.h"
+#include "voxStats.h"
+#include "runLabels.h"
+#include "voxParity.h"
+#include "voxDistance.h"
+#include "voxAssembly.h"
+#include "voxMorphology.h"
+#include "voxComponents.h"
+#include "voxEstimate.h"
 
 class stl2vox{
 private:
-    struct Int3 { int x, y, z; };
+    static int MaxThreads(){
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
 
-    static void printProgress(const std::string &prefix, size_t done, size_t total) {
-        if (total == 0) return;
-        int perc = int((double)done / (double)total * 100.0);
-        std::cout << '\r' << prefix << " " << perc << "% (" << done << "/" << total << ")" << std::flush;
+    static int ThreadId(){
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
     }
 
-    static void InputDimension(voxGrid &voxgrid){
-        int numX, numY, numZ;
-        std::cout << "Please Enter the Number of Voxels in X, Y, Z direction: ";
-        std::cin >> numX >> numY >> numZ;
+    // Voxel index range covered by the bounding box of triangle t, clamped to the grid.
+    template<typename Mesh>
+    static void TriangleVoxelRange(const Mesh &mesh, size_t t, const double origin[3], const double spacing[3],
+                                   const int dim[3], int lo[3], int hi[3]){
+        double minT[3], maxT[3];
+        mesh.bounds(t, minT, maxT);
+
+        for(int k = 0; k < 3; ++k){
+            lo[k] = std::max(0, (int)std::floor((minT[k] - origin[k]) / spacing[k]));
+            hi[k] = std::min(dim[k] - 1, (int)std::ceil((maxT[k] - origin[k]) / spacing[k]));
+        }
+    }
+
+    // Candidate and overlapping voxel counts of the triangle/box tests.
+    struct RasterCounters {
+        size_t tests = 0;
+        size_t hits = 0;
+    };
+
+    // Calls emit(y, z, w, mask) for every 64-voxel word w of row (y, z) inside
+    // [lo, hi] that contains voxels overlapping the triangle. Only the rows a
+    // layer's slice of the triangle can reach, and in each row only the run of
+    // voxels the triangle's slab passes through, are tested, so a large
+    // oblique triangle costs about its area instead of its box volume. Voxels
+    // are tested in Real, see TriBoxTest::RowMask.
+    template<typename Real, typename Emit>
+    static void RasterizeRows(const TriBoxTest &test, const int lo[3], const int hi[3], Emit &&emit,
+                              RasterCounters *counters){
+        for(int z = lo[2]; z <= hi[2]; ++z){
+            int y0 = lo[1], y1 = hi[1];
+            if(!test.LayerRows(z, lo[0], hi[0], y0, y1)) continue;
+            for(int y = y0; y <= y1; ++y){
+                int r0 = lo[0], r1 = hi[0];
+                if(!test.RowRange(y, z, r0, r1)) continue;
+                for(int w = r0 >> 6; w <= r1 >> 6; ++w){
+                    const int x0 = std::max(r0, w * 64);
+                    const int x1 = std::min(r1, w * 64 + 63);
+                    const uint64_t mask = test.template RowMask<Real>(y, z, x0, x1 - x0 + 1) << (x0 - w * 64);
+                    if(counters){
+                        counters->tests += x1 - x0 + 1;
+                        counters->hits += __builtin_popcountll(mask);
+                    }
+                    if(mask != 0) emit(y, z, w, mask);
+                }
+            }
+        }
+    }
+
+    template<typename Emit>
+    static void RasterizeTriangle(const TriBoxTest &test, const int lo[3], const int hi[3], Precision precision,
+                                  Emit &&emit, RasterCounters *counters = nullptr){
+        if (precision == Precision::Float) RasterizeRows<float>(test, lo, hi, emit, counters);
+        else RasterizeRows<double>(test, lo, hi, emit, counters);
+    }
+
+    static void AddCounters(voxStats *stats, const RasterCounters &counters){
+        if(stats == nullptr) return;
+        stats->triangleVoxelTests += counters.tests;
+        stats->triangleVoxelHits += counters.hits;
+    }
+
+    // Takes the grid size from the options, or asks for it on stdin when unset.
+    template<typename Grid>
+    static void InputDimension(Grid &voxgrid, const voxOptions &options){
+        int numX = options.dim[0], numY = options.dim[1], numZ = options.dim[2];
+        if (numX <= 0 || numY <= 0 || numZ <= 0) {
+            std::cout << "Please Enter the Number of Voxels in X, Y, Z direction: ";
+            std::cin >> numX >> numY >> numZ;
+        }
+        if (!std::cin || numX <= 0 || numY <= 0 || numZ <= 0) {
+            throw std::runtime_error("Invalid voxel grid dimension");
+        }
 
         voxgrid.dim[0] = numX;
         voxgrid.dim[1] = numY;
         voxgrid.dim[2] = numZ;
-
-        voxgrid.value.resize((size_t)numX * numY * numZ, 1);
     }
 
-    static void InitBackGrid(STLMesh &stlmesh, voxGrid &voxgrid){
-        Vector3d maxGrid = stlmesh.triangleList[0].max();
-        Vector3d minGrid = stlmesh.triangleList[0].min();
+    // Fits the grid around the mesh with two voxels of padding per side. With
+    // margin > 0 that many more voxels are added on every side at the same
+    // spacing. With align > 1 every dim is then rounded up to a multiple of
+    // align by adding whole voxels around the box, so the spacing stays the
+    // same and grids of 2, 4, ... times coarser spacing nest exactly inside it.
+    template<typename Mesh, typename Grid>
+    static void InitBackGrid(Mesh &stlmesh, Grid &voxgrid, int align = 1, int margin = 0){
+        double lo[3], hi[3];
+        stlmesh.bounds(0, lo, hi);
+        Vector3d minGrid(lo[0], lo[1], lo[2]);
+        Vector3d maxGrid(hi[0], hi[1], hi[2]);
 
-        for(const auto &triangle : stlmesh.triangleList)
+        for(size_t t = 1; t < stlmesh.size(); ++t)
         {
-            auto maxTriangle = triangle.max();
-            auto minTriangle = triangle.min();
-
-            maxGrid = maxGrid.max(maxTriangle);
-            minGrid = minGrid.min(minTriangle);
+            stlmesh.bounds(t, lo, hi);
+            maxGrid = maxGrid.max(Vector3d(hi[0], hi[1], hi[2]));
+            minGrid = minGrid.min(Vector3d(lo[0], lo[1], lo[2]));
         }
 
+        const double boxLo[3] = { minGrid.x, minGrid.y, minGrid.z };
+        const double boxHi[3] = { maxGrid.x, maxGrid.y, maxGrid.z };
+        FitBox(boxLo, boxHi, voxgrid, align, margin);
+    }
+
+    // InitBackGrid for the box [lo, hi] and the dims already in voxgrid.
+    template<typename Grid>
+    static void FitBox(const double lo[3], const double hi[3], Grid &voxgrid, int align, int margin){
+        Vector3d minGrid(lo[0], lo[1], lo[2]);
+        Vector3d maxGrid(hi[0], hi[1], hi[2]);
+
         auto voxelSize = Vector3d(
             (maxGrid.x - minGrid.x) / voxgrid.dim[0],
             (maxGrid.y - minGrid.y) / voxgrid.dim[1],
@@ -98,212 +203,1280 @@ private:
         voxgrid.spacing[0] = voxelSize.x;
         voxgrid.spacing[1] = voxelSize.y;
         voxgrid.spacing[2] = voxelSize.z;
+
+        PadGrid(voxgrid, align, margin);
     }
 
-    static bool isSegmentIntersectTriangle(const Vector3d& p1, const Vector3d& p2, const Triangle& triangle)
-    {
-        Vector3d edge1 = triangle.v1 - triangle.v0;
-        Vector3d edge2 = triangle.v2 - triangle.v0;
-        Vector3d dir = p2 - p1;
-        Vector3d h = dir.cross(edge2);
-
-        double a = edge1.dot(h);
-        if (std::abs(a) < 1e-6)
-            return false;
-
-        double f = 1.0 / a;
-        Vector3d s = p1 - triangle.v0;
-        double u = f * s.dot(h);
-        if (u < 0.0 || u > 1.0)
-            return false;
-
-        Vector3d q = s.cross(edge1);
-        double v = f * dir.dot(q);
-        if (v < 0.0 || u + v > 1.0)
-            return false;
-
-        double t = f * edge2.dot(q);
-        return t >= 0.0 && t <= 1.0;
-    }
-
-    static bool voxelIntersectsTriangle(const Vector3d& voxelMin, const Vector3d& voxelMax, const Triangle& triangle) 
-    {
-        Vector3d vertices[8] = {
-            Vector3d(voxelMin.x, voxelMin.y, voxelMin.z),
-            Vector3d(voxelMax.x, voxelMin.y, voxelMin.z),
-            Vector3d(voxelMin.x, voxelMax.y, voxelMin.z),
-            Vector3d(voxelMax.x, voxelMax.y, voxelMin.z),
-            Vector3d(voxelMin.x, voxelMin.y, voxelMax.z),
-            Vector3d(voxelMax.x, voxelMin.y, voxelMax.z),
-            Vector3d(voxelMin.x, voxelMax.y, voxelMax.z),
-            Vector3d(voxelMax.x, voxelMax.y, voxelMax.z)
-        };
+    // Cubic voxels of edge size around the box [lo, hi], centered on it with
+    // at least two voxels of padding per side, then padded as InitBackGrid does.
+    template<typename Grid>
+    static void FitCubic(const double lo[3], const double hi[3], double size, Grid &voxgrid, int align, int margin){
+        for (int k = 0; k < 3; ++k) {
+            const double cells = std::ceil((hi[k] - lo[k]) / size);
+            if (!(cells < double(1 << 29))) throw std::runtime_error("Voxel size too small for the mesh");
+            voxgrid.dim[k] = std::max(1, (int)cells) + 4;
+            voxgrid.spacing[k] = size;
+            voxgrid.origin[k] = (lo[k] + hi[k]) / 2 - voxgrid.dim[k] * size / 2;
+        }
+        PadGrid(voxgrid, align, margin);
+    }
 
-        int edges[12][2] = {
-            {0, 1}, {1, 3}, {3, 2}, {2, 0}, 
-            {4, 5}, {5, 7}, {7, 6}, {6, 4}, 
-            {0, 4}, {1, 5}, {2, 6}, {3, 7}  
-        };
+    // The margin and alignment of InitBackGrid, at the grid's spacing.
+    template<typename Grid>
+    static void PadGrid(Grid &voxgrid, int align, int margin){
+        for (int k = 0; k < 3; ++k) {
+            voxgrid.origin[k] -= margin * voxgrid.spacing[k];
+            voxgrid.dim[k] += 2 * margin;
+        }
+
+        if (align <= 1) return;
+        for (int k = 0; k < 3; ++k) {
+            const int extra = (voxgrid.dim[k] + align - 1) / align * align - voxgrid.dim[k];
+            voxgrid.origin[k] -= (extra / 2) * voxgrid.spacing[k];
+            voxgrid.dim[k] += extra;
+        }
+    }
+
+    template<typename Mesh>
+    static void ComfirmSurfaceVoxels(Mesh &stlmesh, voxGrid &voxgrid, const voxOptions &options){
+        voxStats *stats = options.stats;
+        const bool report = stats && stats->progress;
+        const long long triCount = (long long)stlmesh.size();
+        const size_t step = std::max<size_t>(1, triCount / 100);
+        size_t processed = 0, tests = 0, hits = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:tests, hits)
+#endif
+        for (long long t = 0; t < triCount; ++t) {
+            const Triangle &triangle = stlmesh.triangle(t);
+            int lo[3], hi[3];
+            TriangleVoxelRange(stlmesh, t, voxgrid.origin, voxgrid.spacing, voxgrid.dim, lo, hi);
+
+            RasterCounters counters;
+            const TriBoxTest test(triangle, voxgrid.origin, voxgrid.spacing);
+            RasterizeTriangle(test, lo, hi, options.precision, [&](int y, int z, int w, uint64_t mask) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+                voxgrid.surfaceRow(y, z)[w] |= mask;
+            }, stats ? &counters : nullptr);
+            tests += counters.tests;
+            hits += counters.hits;
 
-        for (int i = 0; i < 12; i++) {
-            Vector3d p1 = vertices[edges[i][0]];
-            Vector3d p2 = vertices[edges[i][1]];
-            if (isSegmentIntersectTriangle(p1, p2, triangle)) {
-                return true;
+            if (report) {
+                size_t done;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+                done = ++processed;
+                if (done % step == 0) {
+#ifdef _OPENMP
+#pragma omp critical(stl2vox_progress)
+#endif
+                    stats->progress("surface", done, (size_t)triCount);
+                }
             }
         }
 
-        return false;
-    }   
+        AddCounters(stats, {tests, hits});
+    }
+
+    // Triangle lists per Z slab of `depth` layers, stored as offsets into one
+    // index array (slab s owns indices[offsets[s] .. offsets[s+1])).
+    struct SlabBins {
+        int depth = 1;
+        int numSlabs = 0;
+        std::vector<size_t> offsets;
+        std::vector<uint32_t> indices;
+    };
 
-    static void MarkInsideVoxels(int x, int y, int z, voxGrid &voxgrid){
-        voxgrid.value[z * voxgrid.dim[0] * voxgrid.dim[1] + y * voxgrid.dim[0] + x] = 1;
+    static int DefaultSlabDepth(int numZ){
+        return std::max(1, std::min(16, numZ / std::max(1, 4 * MaxThreads())));
     }
 
-    static void ComfirmSurfaceVoxels(STLMesh &stlmesh, voxGrid &voxgrid){
-        const int numX = voxgrid.dim[0]; 
-        const int numY = voxgrid.dim[1]; 
-        const int numZ = voxgrid.dim[2];
+    template<typename Mesh>
+    static void BinTrianglesBySlab(const Mesh &stlmesh, const voxGrid &voxgrid, int depth, SlabBins &bins){
+        const long long triCount = (long long)stlmesh.size();
+        bins.depth = depth;
+        bins.numSlabs = (voxgrid.dim[2] + depth - 1) / depth;
+
+        std::vector<int> first(triCount), last(triCount);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long t = 0; t < triCount; ++t) {
+            int lo[3], hi[3];
+            TriangleVoxelRange(stlmesh, t, voxgrid.origin, voxgrid.spacing, voxgrid.dim, lo, hi);
+            first[t] = lo[2] / depth;
+            last[t] = hi[2] < lo[2] ? first[t] - 1 : hi[2] / depth;
+        }
+
+        bins.offsets.assign(bins.numSlabs + 1, 0);
+        for (long long t = 0; t < triCount; ++t) {
+            for (int b = first[t]; b <= last[t]; ++b) ++bins.offsets[b + 1];
+        }
+        for (int b = 0; b < bins.numSlabs; ++b) bins.offsets[b + 1] += bins.offsets[b];
+
+        std::vector<size_t> cursor(bins.offsets.begin(), bins.offsets.end() - 1);
+        bins.indices.resize(bins.offsets.back());
+        for (long long t = 0; t < triCount; ++t) {
+            for (int b = first[t]; b <= last[t]; ++b) bins.indices[cursor[b]++] = (uint32_t)t;
+        }
+    }
+
+    // Rasterizes the triangles of slab b, clipped to the slab's Z layers.
+    template<typename Mesh, typename Emit>
+    static void RasterizeBin(const Mesh &stlmesh, const voxGrid &voxgrid, const SlabBins &bins, int b,
+                             Precision precision, Emit &&emit, RasterCounters *counters){
+        RasterizeBin(stlmesh, voxgrid, bins, b, bins.offsets[b], bins.offsets[b + 1], precision, emit, counters);
+    }
 
-        const Vector3d minGrid = Vector3d(voxgrid.origin[0], voxgrid.origin[1], voxgrid.origin[2]);
-        const Vector3d voxelSize = Vector3d(voxgrid.spacing[0], voxgrid.spacing[1], voxgrid.spacing[2]);
+    // Same, for the entries [first, last) of the bins' index array only.
+    template<typename Mesh, typename Emit>
+    static void RasterizeBin(const Mesh &stlmesh, const voxGrid &voxgrid, const SlabBins &bins, int b,
+                             size_t first, size_t last, Precision precision, Emit &&emit, RasterCounters *counters){
+        const int z0 = b * bins.depth;
+        const int z1 = std::min(voxgrid.dim[2] - 1, z0 + bins.depth - 1);
+        for (size_t i = first; i < last; ++i) {
+            const size_t t = bins.indices[i];
+            const Triangle &triangle = stlmesh.triangle(t);
+            int lo[3], hi[3];
+            TriangleVoxelRange(stlmesh, t, voxgrid.origin, voxgrid.spacing, voxgrid.dim, lo, hi);
+            lo[2] = std::max(lo[2], z0);
+            hi[2] = std::min(hi[2], z1);
 
-        const size_t triCount = stlmesh.triangleList.size();
-        size_t processed = 0;
+            const TriBoxTest test(triangle, voxgrid.origin, voxgrid.spacing);
+            RasterizeTriangle(test, lo, hi, precision, emit, counters);
+        }
+    }
+
+    // Slab-owned rasterization: every task writes only the rows of its own Z
+    // slab, so no atomics are needed and the result does not depend on timing.
+    template<typename Mesh>
+    static void ComfirmSurfaceVoxelsBinned(Mesh &stlmesh, voxGrid &voxgrid, int depth, const voxOptions &options){
+        voxStats *stats = options.stats;
+        const bool report = stats && stats->progress;
+        SlabBins bins;
+        BinTrianglesBySlab(stlmesh, voxgrid, depth, bins);
+
+        size_t slabsDone = 0, tests = 0, hits = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:tests, hits)
+#endif
+        for (int b = 0; b < bins.numSlabs; ++b) {
+            RasterCounters counters;
+            RasterizeBin(stlmesh, voxgrid, bins, b, options.precision, [&](int y, int z, int w, uint64_t mask) {
+                voxgrid.surfaceRow(y, z)[w] |= mask;
+            }, stats ? &counters : nullptr);
+            tests += counters.tests;
+            hits += counters.hits;
 
+            if (report) {
+                size_t done;
 #ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic)
+#pragma omp atomic capture
 #endif
-        for (size_t t = 0; t < triCount; ++t) {
-            const Triangle &triangle = stlmesh.triangleList[t];
-            Vector3d minTri = triangle.min();
-            Vector3d maxTri = triangle.max();
-
-            int tri_minGrid_x = std::max(0, (int)std::floor((minTri.x - minGrid.x) / voxelSize.x));
-            int tri_minGrid_y = std::max(0, (int)std::floor((minTri.y - minGrid.y) / voxelSize.y));
-            int tri_minGrid_z = std::max(0, (int)std::floor((minTri.z - minGrid.z) / voxelSize.z));
-
-            int tri_maxGrid_x = std::min(numX - 1, (int)std::ceil((maxTri.x - minGrid.x) / voxelSize.x));
-            int tri_maxGrid_y = std::min(numY - 1, (int)std::ceil((maxTri.y - minGrid.y) / voxelSize.y));
-            int tri_maxGrid_z = std::min(numZ - 1, (int)std::ceil((maxTri.z - minGrid.z) / voxelSize.z));
-
-            for(int z = tri_minGrid_z; z <= tri_maxGrid_z; ++z){
-                for(int y = tri_minGrid_y; y <= tri_maxGrid_y; ++y){
-                    for(int x = tri_minGrid_x; x <= tri_maxGrid_x; ++x){
-                        Vector3d minVoxel = Vector3d(
-                            minGrid.x + x * voxelSize.x,
-                            minGrid.y + y * voxelSize.y,
-                            minGrid.z + z * voxelSize.z
-                        );
-                        Vector3d maxVoxel = Vector3d(
-                            minGrid.x + (x + 1) * voxelSize.x,
-                            minGrid.y + (y + 1) * voxelSize.y,
-                            minGrid.z + (z + 1) * voxelSize.z
-                        );
-
-                        if(voxelIntersectsTriangle(minVoxel, maxVoxel, triangle))
-                        {
-                            voxgrid.value[(size_t)z * numX * numY + (size_t)y * numX + (size_t)x] = 0;
+                done = ++slabsDone;
+#ifdef _OPENMP
+#pragma omp critical(stl2vox_progress)
+#endif
+                stats->progress("surface", done, (size_t)bins.numSlabs);
+            }
+        }
+
+        AddCounters(stats, {tests, hits});
+        if (!options.verbose) return;
+        std::cout << "ComfirmSurfaceVoxels: " << stlmesh.size() << " triangles in "
+                  << bins.numSlabs << " slabs (" << bins.indices.size() << " slab references)" << std::endl;
+    }
+
+    static uint64_t ReverseBits(uint64_t x){
+        x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return __builtin_bswap64(x);
+    }
+
+    // Extends seeds s (a subset of free bits f) toward higher bits through the
+    // runs of f they lie in: adding s to f carries through each run from the seed.
+    static uint64_t FillUp(uint64_t f, uint64_t s){
+        return (((f + s) ^ f) & f) | s;
+    }
+
+    // Fills every run of free bits in a row of words that contains a seed.
+    // o holds the seeds on entry and the filled row on exit.
+    static void FillRow(const uint64_t *f, uint64_t *o, int words){
+        uint64_t carry = 0;
+        for(int w = 0; w < words; ++w){
+            const uint64_t s = (o[w] | carry) & f[w];
+            o[w] = FillUp(f[w], s);
+            carry = (o[w] >> 63) & 1;
+        }
+        carry = 0;
+        for(int w = words - 1; w >= 0; --w){
+            const uint64_t rf = ReverseBits(f[w]);
+            const uint64_t s = (ReverseBits(o[w]) | carry) & rf;
+            const uint64_t r = FillUp(rf, s);
+            o[w] = ReverseBits(r);
+            carry = (r >> 63) & 1;
+        }
+    }
+
+    // Brings one Z layer of the outside plane to a fixpoint, taking seeds from
+    // the two neighbouring layers. Returns the number of row updates (0 if no
+    // bit was added).
+    static size_t FillOutsideLayer(voxGrid &voxgrid, int z, std::vector<uint64_t> &freeRow, std::vector<uint64_t> &row){
+        const int numY = voxgrid.dim[1];
+        const int numZ = voxgrid.dim[2];
+        const int words = voxgrid.wordsPerRow;
+        const uint64_t tail = bitRow::TailMask(voxgrid.dim[0]);
+
+        size_t rowUpdates = 0;
+        bool changed = true;
+        while(changed){
+            changed = false;
+            for(int pass = 0; pass < 2; ++pass){
+                for(int i = 0; i < numY; ++i){
+                    const int y = pass == 0 ? i : numY - 1 - i;
+                    const uint64_t *surf = voxgrid.surfaceRow(y, z);
+                    uint64_t *out = voxgrid.outsideRow(y, z);
+                    const uint64_t *nbr[4] = {
+                        y > 0 ? voxgrid.outsideRow(y - 1, z) : nullptr,
+                        y < numY - 1 ? voxgrid.outsideRow(y + 1, z) : nullptr,
+                        z > 0 ? voxgrid.outsideRow(y, z - 1) : nullptr,
+                        z < numZ - 1 ? voxgrid.outsideRow(y, z + 1) : nullptr
+                    };
+
+                    uint64_t grow = 0;
+                    for(int w = 0; w < words; ++w){
+                        freeRow[w] = ~surf[w] & (w == words - 1 ? tail : ~uint64_t(0));
+                        uint64_t s = out[w];
+                        for(int k = 0; k < 4; ++k){
+                            if(nbr[k]) s |= nbr[k][w];
                         }
+                        row[w] = s & freeRow[w];
+                        grow |= row[w] & ~out[w];
                     }
+                    if(grow == 0) continue;
+
+                    FillRow(freeRow.data(), row.data(), words);
+                    for(int w = 0; w < words; ++w) out[w] = row[w];
+                    changed = true;
+                    ++rowUpdates;
                 }
             }
+        }
+        return rowUpdates;
+    }
 
+    // Flood fill from boundary. The outside plane is grown to the least fixpoint
+    // of "free and 6-adjacent to outside or on the boundary", one Z layer at a
+    // time: layers of one parity are filled in parallel while the other parity
+    // is read-only, and only layers next to a change are revisited.
+    static void ComfirmOutsideVoxels(voxGrid &voxgrid, const voxOptions &options){
+        const int numX = voxgrid.dim[0];
+        const int numY = voxgrid.dim[1];
+        const int numZ = voxgrid.dim[2];
+        const int words = voxgrid.wordsPerRow;
+        const uint64_t tail = bitRow::TailMask(numX);
+
+        // Seed every free voxel on the boundary.
 #ifdef _OPENMP
-#pragma omp atomic
+#pragma omp parallel for schedule(static)
 #endif
-            ++processed;
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                const uint64_t *surf = voxgrid.surfaceRow(y, z);
+                uint64_t *out = voxgrid.outsideRow(y, z);
+                const bool wholeRow = (y == 0 || z == 0 || y == numY-1 || z == numZ-1);
+                for (int w = 0; w < words; ++w) {
+                    uint64_t seeds = wholeRow ? ~uint64_t(0) : 0;
+                    if (w == 0) seeds |= 1;
+                    if (w == (numX - 1) >> 6) seeds |= uint64_t(1) << ((numX - 1) & 63);
+                    out[w] = seeds & ~surf[w] & (w == words - 1 ? tail : ~uint64_t(0));
+                }
+            }
+        }
 
-            if ((processed % std::max<size_t>(1, triCount / 100)) == 0) {
-#ifndef _OPENMP
-                printProgress("ComfirmSurfaceVoxels:", processed, triCount);
+        std::vector<char> active(numZ, 1);
+        std::vector<size_t> changed(numZ, 0);
+        size_t rounds = 0, layersFilled = 0, rowUpdates = 0;
+        bool any = true;
+        while (any) {
+            any = false;
+            for (int parity = 0; parity < 2; ++parity) {
+                const int count = (numZ - parity + 1) / 2;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+                {
+                    std::vector<uint64_t> freeRow(words), row(words);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
 #endif
+                    for (int k = 0; k < count; ++k) {
+                        const int z = parity + 2 * k;
+                        if (!active[z]) continue;
+                        active[z] = 0;
+                        changed[z] = FillOutsideLayer(voxgrid, z, freeRow, row);
+                    }
+                }
+
+                for (int z = parity; z < numZ; z += 2) {
+                    if (!changed[z]) continue;
+                    rowUpdates += changed[z];
+                    changed[z] = 0;
+                    ++layersFilled;
+                    any = true;
+                    if (z > 0) active[z - 1] = 1;
+                    if (z < numZ - 1) active[z + 1] = 1;
+                }
             }
+            ++rounds;
+            if (options.stats && options.stats->progress) options.stats->progress("outside", rounds, 0);
         }
 
-#ifndef _OPENMP
-        printProgress("ComfirmSurfaceVoxels:", triCount, triCount);
-        std::cout << std::endl;
+        if (options.stats) {
+            options.stats->fillRounds += rounds;
+            options.stats->fillRowUpdates += rowUpdates;
+        }
+        if (!options.verbose) return;
+        std::cout << "ComfirmOutsideVoxels: " << rounds << " rounds, " << layersFilled << " layer fills" << std::endl;
+    }
+
+    // Allocates every brick whose box overlaps a triangle, then rasterizes the
+    // surface voxels into those bricks.
+    template<typename Mesh>
+    static void ComfirmSurfaceBricks(Mesh &stlmesh, sparseGrid &grid, Precision precision, voxStats *stats){
+        const int B = sparseGrid::brickSize;
+        const double brickSpacing[3] = { grid.spacing[0] * B, grid.spacing[1] * B, grid.spacing[2] * B };
+        const long long triCount = (long long)stlmesh.size();
+
+        std::vector<std::vector<uint64_t>> touched(MaxThreads());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
 #endif
+        for (long long t = 0; t < triCount; ++t) {
+            const Triangle &triangle = stlmesh.triangle(t);
+            int lo[3], hi[3];
+            TriangleVoxelRange(stlmesh, t, grid.origin, brickSpacing, grid.numBricks, lo, hi);
+
+            const TriBoxTest test(triangle, grid.origin, brickSpacing);
+            std::vector<uint64_t> &keys = touched[ThreadId()];
+            RasterizeTriangle(test, lo, hi, Precision::Double, [&](int by, int bz, int w, uint64_t mask) {
+                while(mask){
+                    const int bx = w * 64 + __builtin_ctzll(mask);
+                    mask &= mask - 1;
+                    keys.push_back(grid.cellKey(bx, by, bz));
+                }
+            });
+        }
+
+        std::vector<uint64_t> keys;
+        for(auto &k : touched){
+            keys.insert(keys.end(), k.begin(), k.end());
+            std::vector<uint64_t>().swap(k);
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        grid.bricks.reserve(keys.size());
+        grid.brickIndex.reserve(keys.size());
+        for(uint64_t key : keys) grid.addBrick(key);
+
+        // Voxels that land in a brick the coarse pass rejected (a rounding corner
+        // case) are collected and inserted afterwards.
+        struct Miss { uint64_t key; int y, z; uint64_t bits; };
+        std::vector<std::vector<Miss>> missed(MaxThreads());
+
+        size_t tests = 0, hits = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:tests, hits)
+#endif
+        for (long long t = 0; t < triCount; ++t) {
+            const Triangle &triangle = stlmesh.triangle(t);
+            int lo[3], hi[3];
+            TriangleVoxelRange(stlmesh, t, grid.origin, grid.spacing, grid.dim, lo, hi);
+
+            RasterCounters counters;
+            const TriBoxTest test(triangle, grid.origin, grid.spacing);
+            RasterizeTriangle(test, lo, hi, precision, [&](int y, int z, int w, uint64_t mask) {
+                for(int b = 0; b < 8; ++b){
+                    const uint64_t lane = (mask >> (b * 8)) & 0xFF;
+                    if(lane == 0) continue;
+                    const uint64_t key = grid.cellKey(w * 8 + b, y >> 3, z >> 3);
+                    const uint64_t bits = lane << ((y & 7) * 8);
+                    voxBrick *brick = grid.findBrick(key);
+                    if(brick == nullptr){
+                        missed[ThreadId()].push_back({key, y, z, bits});
+                        continue;
+                    }
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+                    brick->surface[z & 7] |= bits;
+                }
+            }, stats ? &counters : nullptr);
+            tests += counters.tests;
+            hits += counters.hits;
+        }
+        AddCounters(stats, {tests, hits});
+
+        for(const auto &list : missed){
+            for(const Miss &m : list){
+                grid.addBrick(m.key).surface[m.z & 7] |= m.bits;
+            }
+        }
     }
 
-    // Flood fill from boundary
-    static void ComfirmOutsideVoxels(voxGrid &voxgrid){
-        const int numX = voxgrid.dim[0]; 
-        const int numY = voxgrid.dim[1]; 
-        const int numZ = voxgrid.dim[2];
+    // Flood fill from the grid boundary over bricks and tiles. An unallocated
+    // cell has no surface voxels, so reaching any of its voxels makes the whole
+    // tile outside; allocated bricks are filled voxel by voxel with word masks.
+    static void ComfirmOutsideBricks(sparseGrid &grid, voxStats *stats){
+        const int nb[3] = { grid.numBricks[0], grid.numBricks[1], grid.numBricks[2] };
+        const uint64_t colX0 = 0x0101010101010101ULL;
+        const uint64_t colX7 = colX0 << 7;
+        const uint64_t rowY0 = 0xFFULL;
+        const uint64_t rowY7 = rowY0 << 56;
+        const uint64_t full = ~uint64_t(0);
 
-        auto idx = [&](int x, int y, int z) -> size_t {
-            return (size_t)z * numX * numY + (size_t)y * numX + (size_t)x;
+        auto validMask = [&](int bx, int by, int bz, uint64_t valid[8]) {
+            const int nx = std::min(8, grid.dim[0] - bx * 8);
+            const int ny = std::min(8, grid.dim[1] - by * 8);
+            const int nz = std::min(8, grid.dim[2] - bz * 8);
+            uint64_t layer = 0;
+            for(int y = 0; y < ny; ++y) layer |= ((uint64_t(1) << nx) - 1) << (y * 8);
+            for(int z = 0; z < 8; ++z) valid[z] = z < nz ? layer : 0;
         };
 
-        std::queue<Int3> q;
-        std::vector<char> visited((size_t)numX * numY * numZ, 0);
+        // Outside voxels of cell (bx, by, bz) on its face toward direction d,
+        // already moved onto the opposite face of the receiving neighbour.
+        // d: 0 -x, 1 +x, 2 -y, 3 +y, 4 -z, 5 +z (as seen from the receiver).
+        auto faceSeeds = [&](int bx, int by, int bz, int d, uint64_t seeds[8]) {
+            for(int z = 0; z < 8; ++z) seeds[z] = 0;
+            uint64_t key = grid.cellKey(bx, by, bz);
+            const voxBrick *brick = grid.findBrick(key);
+            if(brick == nullptr){
+                if(!grid.isOutsideTile(key)) return;
+                for(int z = 0; z < 8; ++z){
+                    if(d == 0) seeds[z] = colX0;
+                    if(d == 1) seeds[z] = colX7;
+                    if(d == 2) seeds[z] = rowY0;
+                    if(d == 3) seeds[z] = rowY7;
+                }
+                if(d == 4) seeds[0] = full;
+                if(d == 5) seeds[7] = full;
+                return;
+            }
+            for(int z = 0; z < 8; ++z){
+                const uint64_t o = brick->outside[z];
+                if(d == 0) seeds[z] = (o & colX7) >> 7;
+                if(d == 1) seeds[z] = (o & colX0) << 7;
+                if(d == 2) seeds[z] = (o & rowY7) >> 56;
+                if(d == 3) seeds[z] = (o & rowY0) << 56;
+            }
+            if(d == 4) seeds[0] = brick->outside[7];
+            if(d == 5) seeds[7] = brick->outside[0];
+        };
 
-        size_t boundaryCount = 0;
-        for (int z = 0; z < numZ; ++z) {
-            for (int y = 0; y < numY; ++y) {
-                for (int x = 0; x < numX; ++x) {
-                    bool isBoundary = (x == 0 || y == 0 || z == 0 || x == numX-1 || y == numY-1 || z == numZ-1);
-                    if (!isBoundary) continue;
-                    size_t id = idx(x,y,z);
-                    if (voxgrid.value[id] != 0 && !visited[id]) { 
-                        voxgrid.value[id] = -1;
-                        visited[id] = 1;
-                        q.push({x,y,z});
-                        ++boundaryCount;
+        static constexpr int dirs[6][3] = {
+            {-1,0,0},{1,0,0},
+            {0,-1,0},{0,1,0},
+            {0,0,-1},{0,0,1}
+        };
+
+        std::vector<uint64_t> queued((grid.numCells() + 63) / 64, 0);
+        std::vector<uint64_t> work;
+        size_t pushes = 0;
+        auto push = [&](int bx, int by, int bz) {
+            if(bx < 0 || by < 0 || bz < 0 || bx >= nb[0] || by >= nb[1] || bz >= nb[2]) return;
+            uint64_t key = grid.cellKey(bx, by, bz);
+            if((queued[key >> 6] >> (key & 63)) & 1) return;
+            queued[key >> 6] |= uint64_t(1) << (key & 63);
+            work.push_back(key);
+            ++pushes;
+        };
+
+        for(int bz = 0; bz < nb[2]; ++bz){
+            for(int by = 0; by < nb[1]; ++by){
+                for(int bx = 0; bx < nb[0]; ++bx){
+                    if(bx == 0 || by == 0 || bz == 0 || bx == nb[0]-1 || by == nb[1]-1 || bz == nb[2]-1){
+                        push(bx, by, bz);
                     }
                 }
             }
         }
 
-        size_t processed = 0;
-        const int dirs[6][3] = {
-            {1,0,0},{-1,0,0},
-            {0,1,0},{0,-1,0},
-            {0,0,1},{0,0,-1}
-        };
+        while(!work.empty()){
+            const uint64_t key = work.back();
+            work.pop_back();
+            queued[key >> 6] &= ~(uint64_t(1) << (key & 63));
 
-        // BFS
-        while (!q.empty()) {
-            Int3 cur = q.front(); q.pop();
-            ++processed;
-            if ((processed & 0x3FF) == 0) {
-                printProgress("ComfirmOutsideVoxels BFS:", processed, (size_t)numX * numY * numZ);
-            }
-
-            for (int k = 0; k < 6; ++k) {
-                int nx = cur.x + dirs[k][0];
-                int ny = cur.y + dirs[k][1];
-                int nz = cur.z + dirs[k][2];
-                if (nx < 0 || nx >= numX || ny < 0 || ny >= numY || nz < 0 || nz >= numZ) continue;
-                size_t nid = idx(nx, ny, nz);
-
-                if (!visited[nid] && voxgrid.value[nid] != 0) {
-                    visited[nid] = 1;
-                    voxgrid.value[nid] = -1;
-                    q.push({nx, ny, nz});
+            const int bx = (int)(key % nb[0]);
+            const int by = (int)((key / nb[0]) % nb[1]);
+            const int bz = (int)(key / ((uint64_t)nb[0] * nb[1]));
+
+            uint64_t valid[8], seeds[8] = {0}, incoming[8];
+            validMask(bx, by, bz, valid);
+
+            // Voxels on the grid boundary are always seeds.
+            const int lx = (grid.dim[0] - 1) & 7, ly = (grid.dim[1] - 1) & 7, lz = (grid.dim[2] - 1) & 7;
+            for(int z = 0; z < 8; ++z){
+                if(bx == 0) seeds[z] |= colX0;
+                if(bx == nb[0]-1) seeds[z] |= colX0 << lx;
+                if(by == 0) seeds[z] |= rowY0;
+                if(by == nb[1]-1) seeds[z] |= rowY0 << (ly * 8);
+            }
+            if(bz == 0) seeds[0] = full;
+            if(bz == nb[2]-1) seeds[lz] = full;
+
+            for(int d = 0; d < 6; ++d){
+                const int nx = bx + dirs[d][0], ny = by + dirs[d][1], nz = bz + dirs[d][2];
+                if(nx < 0 || ny < 0 || nz < 0 || nx >= nb[0] || ny >= nb[1] || nz >= nb[2]) continue;
+                faceSeeds(nx, ny, nz, d, incoming);
+                for(int z = 0; z < 8; ++z) seeds[z] |= incoming[z];
+            }
+
+            voxBrick *brick = grid.findBrick(key);
+            if(brick == nullptr){
+                if(grid.isOutsideTile(key)) continue;
+                bool reached = false;
+                for(int z = 0; z < 8; ++z) reached |= (seeds[z] & valid[z]) != 0;
+                if(!reached) continue;
+                grid.setOutsideTile(key);
+                for(int d = 0; d < 6; ++d) push(bx + dirs[d][0], by + dirs[d][1], bz + dirs[d][2]);
+                continue;
+            }
+
+            uint64_t freeMask[8], o[8];
+            for(int z = 0; z < 8; ++z){
+                freeMask[z] = valid[z] & ~brick->surface[z];
+                o[z] = brick->outside[z] | (seeds[z] & freeMask[z]);
+            }
+            bool changed = true;
+            while(changed){
+                changed = false;
+                for(int z = 0; z < 8; ++z){
+                    uint64_t w = o[z];
+                    uint64_t g = w | ((w << 1) & ~colX0) | ((w >> 1) & ~colX7) | (w << 8) | (w >> 8);
+                    if(z > 0) g |= o[z - 1];
+                    if(z < 7) g |= o[z + 1];
+                    g &= freeMask[z];
+                    if(g != w){
+                        o[z] = g;
+                        changed = true;
+                    }
+                }
+            }
+
+            uint64_t added[8], any = 0;
+            for(int z = 0; z < 8; ++z){
+                added[z] = o[z] & ~brick->outside[z];
+                brick->outside[z] = o[z];
+                any |= added[z];
+            }
+            if(any == 0) continue;
+
+            uint64_t faceAny[6] = {0, 0, 0, 0, 0, 0};
+            for(int z = 0; z < 8; ++z){
+                faceAny[0] |= added[z] & colX0;
+                faceAny[1] |= added[z] & colX7;
+                faceAny[2] |= added[z] & rowY0;
+                faceAny[3] |= added[z] & rowY7;
+            }
+            faceAny[4] = added[0];
+            faceAny[5] = added[7];
+            for(int d = 0; d < 6; ++d){
+                if(faceAny[d]) push(bx + dirs[d][0], by + dirs[d][1], bz + dirs[d][2]);
+            }
+        }
+
+        if(stats) stats->fillPushes += pushes;
+    }
+
+    // Bricks without surface voxels that ended up uniformly inside or outside
+    // are replaced by tiles.
+    static void CollapseUniformBricks(sparseGrid &grid){
+        std::unordered_map<uint64_t, uint32_t> index;
+        std::vector<voxBrick> kept;
+        index.reserve(grid.brickIndex.size());
+        kept.reserve(grid.bricks.size());
+
+        for(const auto &entry : grid.brickIndex){
+            const voxBrick &brick = grid.bricks[entry.second];
+            const int bx = (int)(entry.first % grid.numBricks[0]);
+            const int by = (int)((entry.first / grid.numBricks[0]) % grid.numBricks[1]);
+            const int bz = (int)(entry.first / ((uint64_t)grid.numBricks[0] * grid.numBricks[1]));
+
+            bool noSurface = true, allOutside = true, noOutside = true;
+            for(int z = 0; z < 8; ++z){
+                const int nx = std::min(8, grid.dim[0] - bx * 8);
+                const int ny = std::min(8, grid.dim[1] - by * 8);
+                uint64_t valid = 0;
+                if(z < grid.dim[2] - bz * 8){
+                    for(int y = 0; y < ny; ++y) valid |= ((uint64_t(1) << nx) - 1) << (y * 8);
                 }
+                noSurface &= brick.surface[z] == 0;
+                allOutside &= (brick.outside[z] & valid) == valid;
+                noOutside &= brick.outside[z] == 0;
+            }
+
+            if(noSurface && allOutside){
+                grid.setOutsideTile(entry.first);
+            }else if(!(noSurface && noOutside)){
+                index.emplace(entry.first, (uint32_t)kept.size());
+                kept.push_back(brick);
             }
         }
 
-        printProgress("ComfirmOutsideVoxels BFS:", processed, (size_t)numX * numY * numZ);
-        std::cout << std::endl;
+        grid.brickIndex.swap(index);
+        grid.bricks.swap(kept);
+    }
+
+    // Z layers per streamed slab: as many as keep the two bit planes of a slab
+    // at about 256 MiB.
+    static int DefaultStreamDepth(const voxGrid &grid){
+        const size_t layerBytes = std::max<size_t>(1, (size_t)2 * sizeof(uint64_t) * grid.wordsPerRow * grid.dim[1]);
+        const size_t budget = std::max<size_t>(1, (size_t(256) << 20) / layerBytes);
+        return (int)std::min<size_t>(grid.dim[2], budget);
+    }
+
+    // Rasterizes grid layers [z0, z0 + slab.dim[2]) into the surface plane of
+    // slab and leaves the free voxels of those layers in its outside plane. The
+    // slab starts on a bin boundary, so each bin owns whole slab layers.
+    template<typename Mesh>
+    static void RasterizeStreamSlab(const Mesh &stlmesh, const voxGrid &grid, const SlabBins &bins,
+                                    voxGrid &slab, int z0, Precision precision, voxStats *stats){
+        const int nz = slab.dim[2];
+        const int numY = slab.dim[1];
+        const int words = slab.wordsPerRow;
+        const uint64_t tail = bitRow::TailMask(slab.dim[0]);
+        const int b0 = z0 / bins.depth;
+        const int b1 = (z0 + nz - 1) / bins.depth;
+
+        size_t tests = 0, hits = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:tests, hits)
+#endif
+        for (int b = b0; b <= b1; ++b) {
+            const int zBegin = b * bins.depth - z0;
+            const int zEnd = std::min(nz, zBegin + bins.depth);
+            std::fill(slab.surfaceRow(0, zBegin), slab.surfaceRow(0, zEnd), uint64_t(0));
+
+            RasterCounters counters;
+            RasterizeBin(stlmesh, grid, bins, b, precision, [&](int y, int z, int w, uint64_t mask) {
+                slab.surfaceRow(y, z - z0)[w] |= mask;
+            }, stats ? &counters : nullptr);
+            tests += counters.tests;
+            hits += counters.hits;
+
+            for (int z = zBegin; z < zEnd; ++z) {
+                for (int y = 0; y < numY; ++y) {
+                    const uint64_t *surf = slab.surfaceRow(y, z);
+                    uint64_t *free = slab.outsideRow(y, z);
+                    for (int w = 0; w < words; ++w) free[w] = ~surf[w] & (w == words - 1 ? tail : ~uint64_t(0));
+                }
+            }
+        }
+        AddCounters(stats, {tests, hits});
+    }
+
+    // flag[root] bit 0 is set for every component of the slab's free runs that
+    // touches the boundary of the whole grid.
+    static void MarkBoundaryComponents(const runTable &runs, const voxGrid &grid, int z0, std::vector<uint8_t> &flag){
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        flag.assign(runs.numRuns(), 0);
+        for (int z = 0; z < runs.dim[2]; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                const bool wholeRow = (y == 0 || y == numY - 1 || z0 + z == 0 || z0 + z == numZ - 1);
+                for (size_t i = runs.rowBegin(y, z); i < runs.rowEnd(y, z); ++i) {
+                    if (wholeRow || runs.x0[i] == 0 || runs.x1[i] == numX - 1) flag[runs.parent[i]] |= 1;
+                }
+            }
+        }
+    }
+
+    // Free runs of the last layer of a streamed slab, with the interface
+    // component each run belongs to.
+    struct StreamInterface {
+        std::vector<size_t> rowStart;
+        std::vector<int> x0, x1;
+        std::vector<uint32_t> component;
+    };
+
+    // (local root, interface component) pairs of one slab, sorted by root.
+    typedef std::vector<std::pair<uint32_t, uint32_t>> SlabComponents;
+
+    static uint32_t InterfaceComponent(const SlabComponents &components, uint32_t root){
+        auto it = std::lower_bound(components.begin(), components.end(), std::make_pair(root, uint32_t(0)));
+        return it->second;
+    }
+
+    // Rewrites the outside plane of slab from the runs whose component has
+    // flag bit 0 set.
+    static void MarkOutsideRuns(const runTable &runs, const std::vector<uint8_t> &flag, voxGrid &slab){
+        const int numY = slab.dim[1];
+        const int words = slab.wordsPerRow;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int z = 0; z < slab.dim[2]; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                uint64_t *out = slab.outsideRow(y, z);
+                for (int w = 0; w < words; ++w) out[w] = 0;
+                for (size_t i = runs.rowBegin(y, z); i < runs.rowEnd(y, z); ++i) {
+                    if (!(flag[runs.parent[i]] & 1)) continue;
+                    bitRow::SetRange(out, runs.x0[i], runs.x1[i] + 1);
+                }
+            }
+        }
     }
 
 public:
-    static void Convert(STLMesh &stlmesh, voxGrid &voxgrid){
-        // 0. Get VoxelGrid Dimension
-        InputDimension(voxgrid);
+    template<typename Mesh>
+    static void Convert(Mesh &stlmesh, voxGrid &voxgrid){
+        Convert(stlmesh, voxgrid, voxOptions());
+    }
 
-        // 1. Initial Background Grid
-        InitBackGrid(stlmesh, voxgrid);
+    template<typename Mesh>
+    static void Convert(Mesh &stlmesh, voxGrid &voxgrid, const voxOptions &options){
+        // 0-1. Get VoxelGrid Dimension and Initial Background Grid
+        PrepareGrid(stlmesh, voxgrid, options);
 
         // 2. Comfirm Surface Voxels
-        ComfirmSurfaceVoxels(stlmesh, voxgrid);
+        SurfaceStage(stlmesh, voxgrid, options);
+
+        // 3. Mark Outside Voxels via flood-fill from boundary, or by ray parity
+        OutsideStage(stlmesh, voxgrid, options);
+    }
+
+    // Sizes voxgrid around the mesh without allocating it: by options.dim as
+    // InitBackGrid does, by options.voxelSize, or with neither as the finest
+    // cubic grid within options.memoryBudget. A grid whose estimate is over
+    // the budget is refused, or with options.downgrade coarsened (at the same
+    // proportions) until it fits; options.estimateOnly only reports it.
+    template<typename Mesh, typename Grid>
+    static voxEstimate FitGrid(Mesh &stlmesh, Grid &voxgrid, const voxOptions &options, GridKind kind,
+                               int align = 1, int margin = 0){
+        const meshSummary mesh = meshSummary::Of(stlmesh);
+        const uint64_t budget = options.memoryBudget;
+        const bool hasDim = options.dim[0] > 0 && options.dim[1] > 0 && options.dim[2] > 0;
+        auto estimate = [&]() {
+            return voxEstimate::Of(mesh, voxgrid.dim, voxgrid.spacing, kind, options, MaxThreads());
+        };
+        auto fits = [&](const voxEstimate &e) { return !e.overBudget(); };
+
+        // Finest cubic voxel in [size, largest] that fits, by bisection in log space.
+        auto fitCubic = [&](double size) {
+            double largest = 0;
+            for (int k = 0; k < 3; ++k) largest = std::max(largest, mesh.hi[k] - mesh.lo[k]);
+            largest = std::max(largest, size);
+            FitCubic(mesh.lo, mesh.hi, largest, voxgrid, align, margin);
+            if (!fits(estimate())) return estimate();
+            double over = size, under = largest;
+            for (int i = 0; i < 64 && under / over > 1 + 1e-6; ++i) {
+                const double mid = std::sqrt(over * under);
+                FitCubic(mesh.lo, mesh.hi, mid, voxgrid, align, margin);
+                if (fits(estimate())) under = mid;
+                else over = mid;
+            }
+            FitCubic(mesh.lo, mesh.hi, under, voxgrid, align, margin);
+            return estimate();
+        };
+
+        // Pyramid levels past the size of the grid would only pad it with
+        // empty voxels (up to 2^15 per axis), so they are refused up front.
+        auto checkLevels = [&]() {
+            if (align > std::max({ voxgrid.dim[0], voxgrid.dim[1], voxgrid.dim[2] })) {
+                std::ostringstream message;
+                message << "Too many levels for a grid of " << voxgrid.dim[0] << " x " << voxgrid.dim[1] << " x "
+                        << voxgrid.dim[2] << ": the coarsest would be below one voxel";
+                throw std::runtime_error(message.str());
+            }
+        };
+
+        voxEstimate result;
+        if (options.voxelSize > 0) {
+            FitCubic(mesh.lo, mesh.hi, options.voxelSize, voxgrid, 1, 0);
+            checkLevels();
+            FitCubic(mesh.lo, mesh.hi, options.voxelSize, voxgrid, align, margin);
+            result = estimate();
+            if (!fits(result) && options.downgrade) {
+                result = fitCubic(options.voxelSize);
+                result.downgraded = true;
+            }
+        } else if (!hasDim && budget > 0) {
+            double largest = 0;
+            for (int k = 0; k < 3; ++k) largest = std::max(largest, mesh.hi[k] - mesh.lo[k]);
+            result = fitCubic(largest / double(1 << 28));
+        } else {
+            InputDimension(voxgrid, options);
+            checkLevels();
+            const int requested[3] = { voxgrid.dim[0], voxgrid.dim[1], voxgrid.dim[2] };
+            auto scaled = [&](double scale) {
+                for (int k = 0; k < 3; ++k) voxgrid.dim[k] = std::max(1, (int)(requested[k] * scale));
+                FitBox(mesh.lo, mesh.hi, voxgrid, align, margin);
+                return estimate();
+            };
+            result = scaled(1);
+            if (!fits(result) && options.downgrade && fits(scaled(0))) {
+                double over = 1, under = 0;
+                for (int i = 0; i < 40; ++i) {
+                    const double mid = (over + under) / 2;
+                    if (fits(scaled(mid))) under = mid;
+                    else over = mid;
+                }
+                result = scaled(under);
+                result.downgraded = true;
+            }
+        }
+
+        if (result.overBudget() && !options.estimateOnly) {
+            std::ostringstream message;
+            message << "Grid of " << result.dim[0] << " x " << result.dim[1] << " x " << result.dim[2] << " needs about "
+                    << (result.totalBytes() >> 20) << " MiB, over the memory budget of " << (budget >> 20) << " MiB"
+                    << (options.downgrade ? "" : "; use a coarser grid or --downgrade");
+            throw std::runtime_error(message.str());
+        }
+        return result;
+    }
+
+    // Dims of the finest grid are multiples of this, so that every level of a
+    // pyramid (see voxPyramid) halves them exactly.
+    static int LevelAlignment(const voxOptions &options){
+        return 1 << (std::max(1, options.levels) - 1);
+    }
+
+    // Voxels added around the grid so that the dilations of options.morph
+    // never reach the grid boundary.
+    static int MorphMargin(const voxOptions &options){
+        int margin = 0;
+        for (const morphStep &step : options.morph) {
+            if (step.op == MorphOp::Dilate || step.op == MorphOp::Close) margin += step.radius;
+        }
+        return margin;
+    }
+
+    // The stages of Convert, for benchmarks and callers that drive the pipeline themselves.
+    template<typename Mesh>
+    static void PrepareGrid(Mesh &stlmesh, voxGrid &voxgrid, const voxOptions &options){
+        voxTimer timer(options.stats, "grid");
+        const voxEstimate estimate = FitGrid(stlmesh, voxgrid, options, GridKind::Dense, LevelAlignment(options), MorphMargin(options));
+        if (options.verbose) estimate.print(std::cout);
+        voxgrid.allocate();
+        if (options.stats) {
+            options.stats->triangles = stlmesh.size();
+            options.stats->voxels = voxgrid.numVoxels();
+        }
+    }
+
+    template<typename Mesh>
+    static void SurfaceStage(Mesh &stlmesh, voxGrid &voxgrid, const voxOptions &options){
+        {
+            voxTimer timer(options.stats, "surface");
+            if (options.raster == RasterMode::Slabs) {
+                int depth = options.slabDepth > 0 ? options.slabDepth : DefaultSlabDepth(voxgrid.dim[2]);
+                ComfirmSurfaceVoxelsBinned(stlmesh, voxgrid, depth, options);
+            } else {
+                ComfirmSurfaceVoxels(stlmesh, voxgrid, options);
+            }
+        }
+        if (options.stats) {
+            size_t count = 0;
+            for (uint64_t w : voxgrid.surface) count += __builtin_popcountll(w);
+            options.stats->surfaceVoxels = count;
+        }
+    }
+
+    // The flood fill only needs the surface plane; FillMode::Parity needs the
+    // mesh as well and goes through the overload below.
+    static void OutsideStage(voxGrid &voxgrid, const voxOptions &options){
+        if (options.fill == FillMode::Parity) {
+            throw std::runtime_error("The parity fill needs the mesh");
+        }
+        voxTimer timer(options.stats, "outside");
+        ComfirmOutsideVoxels(voxgrid, options);
+    }
+
+    template<typename Mesh>
+    static void OutsideStage(const Mesh &stlmesh, voxGrid &voxgrid, const voxOptions &options){
+        if (options.fill != FillMode::Parity) {
+            OutsideStage(voxgrid, options);
+            return;
+        }
+        voxTimer timer(options.stats, "outside");
+        const voxParity::Counters counters = voxParity::Classify(stlmesh, voxgrid);
+        if (options.stats) {
+            options.stats->rayCrossings += counters.crossings;
+            options.stats->openRays += counters.openColumns;
+        }
+        if (!options.verbose) return;
+        std::cout << "ComfirmOutsideVoxels: ray parity, " << counters.crossings << " crossings, "
+                  << counters.openColumns << " open rays" << std::endl;
+    }
+
+    // Applies options.morph to a converted grid, see voxMorphology.
+    static void MorphologyStage(voxGrid &voxgrid, const voxOptions &options){
+        if (options.morph.empty()) return;
+        voxTimer timer(options.stats, "morph");
+        voxMorphology::Apply(voxgrid, options.morph);
+        if (!options.verbose) return;
+        std::cout << "Morphology: " << options.morph.size() << " steps" << std::endl;
+    }
+
+    // Bodies and enclosed cavities of a converted grid, see voxComponents.
+    template<typename Mesh>
+    static void ComponentStage(const Mesh &stlmesh, const voxGrid &voxgrid, const voxOptions &options, voxComponents &components){
+        voxTimer timer(options.stats, "components");
+        components.label(stlmesh, voxgrid);
+        if (!options.verbose) return;
+        std::cout << "Components: " << components.numBodies << " bodies, " << components.numCavities << " cavities" << std::endl;
+    }
+
+    // Signed distance field of a converted grid, see voxDistance.
+    template<typename Mesh>
+    static void DistanceStage(const Mesh &stlmesh, const voxGrid &voxgrid, const voxOptions &options, voxField &field){
+        voxTimer timer(options.stats, "distance");
+        const voxDistance::Counters counters = voxDistance::Compute(stlmesh, voxgrid, options.sdfBand, field);
+        if (options.stats) {
+            options.stats->distanceTests += counters.tests;
+            options.stats->sweepRounds += counters.rounds;
+        }
+        if (!options.verbose) return;
+        std::cout << "SignedDistance: " << counters.tests << " distances in a " << options.sdfBand << " voxel band, "
+                  << counters.rounds << " sweep rounds" << std::endl;
+    }
+
+    // Same pipeline as Convert, but on a sparse brick grid whose memory grows
+    // with the surface area instead of the bounding-box volume.
+    template<typename Mesh>
+    static void ConvertSparse(Mesh &stlmesh, sparseGrid &grid){
+        ConvertSparse(stlmesh, grid, voxOptions());
+    }
+
+    template<typename Mesh>
+    static void ConvertSparse(Mesh &stlmesh, sparseGrid &grid, const voxOptions &options){
+        // 0. Get VoxelGrid Dimension
+        {
+            voxTimer timer(options.stats, "grid");
+            const voxEstimate estimate = FitGrid(stlmesh, grid, options, GridKind::Sparse);
+            if (options.verbose) estimate.print(std::cout);
 
-        // 3. Mark Outside Voxels via flood-fill from boundary
-        ComfirmOutsideVoxels(voxgrid);
+            // 1. Initial Background Grid
+            grid.allocate();
+        }
+        if (options.stats) {
+            options.stats->triangles = stlmesh.size();
+            options.stats->voxels = grid.numVoxels();
+        }
+
+        // 2. Comfirm Surface Voxels, allocating bricks where they are touched
+        {
+            voxTimer timer(options.stats, "surface");
+            ComfirmSurfaceBricks(stlmesh, grid, options.precision, options.stats);
+        }
+        if (options.stats) {
+            size_t count = 0;
+            for (const voxBrick &brick : grid.bricks) {
+                for (uint64_t w : brick.surface) count += __builtin_popcountll(w);
+            }
+            options.stats->surfaceVoxels = count;
+        }
+
+        // 3. Mark Outside Voxels via flood-fill over bricks and tiles
+        {
+            voxTimer timer(options.stats, "outside");
+            ComfirmOutsideBricks(grid, options.stats);
+            CollapseUniformBricks(grid);
+        }
+
+        if (!options.verbose) return;
+        std::cout << "Sparse grid: " << grid.bricks.size() << " bricks of " << grid.numCells()
+                  << " cells, " << grid.memoryBytes() / (1024.0 * 1024.0) << " MiB" << std::endl;
+    }
+    // Sets the size, origin and spacing of voxgrid as PrepareGrid does, but
+    // leaves its planes unallocated; the grid only describes what StreamSlabs
+    // produces.
+    template<typename Mesh>
+    static void PrepareStream(Mesh &stlmesh, voxGrid &voxgrid, const voxOptions &options){
+        voxTimer timer(options.stats, "grid");
+        const voxEstimate estimate = FitGrid(stlmesh, voxgrid, options, GridKind::Stream);
+        if (options.verbose) estimate.print(std::cout);
+        voxgrid.wordsPerRow = (voxgrid.dim[0] + 63) / 64;
+        if (options.stats) {
+            options.stats->triangles = stlmesh.size();
+            options.stats->voxels = voxgrid.numVoxels();
+        }
+    }
+
+    // Out-of-core conversion of the grid described by PrepareStream. The grid
+    // is processed in Z slabs of options.streamDepth layers and never held in
+    // memory as a whole; sink(slab, z0) receives each finished slab, in order,
+    // as a voxGrid holding grid layers [z0, z0 + slab.dim[2]).
+    //   Pass 1 rasterizes every slab, labels the connected runs of free voxels
+    //          and joins the components that reach a slab interface with a
+    //          union-find over those components only.
+    //   Pass 2 rasterizes every slab again and marks as outside the components
+    //          that touch the grid boundary, directly or through other slabs.
+    template<typename Mesh, typename Sink>
+    static void StreamSlabs(Mesh &stlmesh, const voxGrid &grid, const voxOptions &options, Sink &&sink){
+        voxStats *stats = options.stats;
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        int depth = options.streamDepth > 0 ? std::min(options.streamDepth, numZ) : DefaultStreamDepth(grid);
+        const int binDepth = options.slabDepth > 0 ? std::min(options.slabDepth, depth) : DefaultSlabDepth(depth);
+        depth = (depth + binDepth - 1) / binDepth * binDepth;
+        const int numSlabs = (numZ + depth - 1) / depth;
+
+        SlabBins bins;
+        {
+            voxTimer timer(stats, "surface");
+            BinTrianglesBySlab(stlmesh, grid, binDepth, bins);
+        }
+
+        voxGrid slab;
+        for (int k = 0; k < 3; ++k) {
+            slab.origin[k] = grid.origin[k];
+            slab.spacing[k] = grid.spacing[k];
+        }
+        slab.dim[0] = numX;
+        slab.dim[1] = numY;
+        slab.dim[2] = depth;
+        slab.allocate();
+
+        runTable runs;
+        std::vector<uint8_t> flag;
+        auto prepare = [&](int s) {
+            const int z0 = s * depth;
+            slab.dim[2] = std::min(depth, numZ - z0);
+            slab.origin[2] = grid.origin[2] + z0 * grid.spacing[2];
+            {
+                voxTimer timer(stats, "surface");
+                RasterizeStreamSlab(stlmesh, grid, bins, slab, z0, options.precision, stats);
+            }
+            voxTimer timer(stats, "outside");
+            runLabeling::Build(runs, numX, numY, slab.dim[2], [&](int y, int z) { return slab.outsideRow(y, z); });
+            runLabeling::Label(runs);
+            MarkBoundaryComponents(runs, grid, z0, flag);
+        };
+
+        // 1. Components crossing slab interfaces
+        disjointSets interfaces;
+        std::vector<uint8_t> interfaceOutside;
+        std::vector<SlabComponents> slabComponents(numSlabs);
+        StreamInterface top;
+        for (int s = 0; s < numSlabs; ++s) {
+            prepare(s);
+            voxTimer timer(stats, "outside");
+            const int nz = slab.dim[2];
+            const bool hasBelow = s > 0, hasAbove = s < numSlabs - 1;
+
+            for (int y = 0; y < numY; ++y) {
+                if (hasBelow) {
+                    for (size_t i = runs.rowBegin(y, 0); i < runs.rowEnd(y, 0); ++i) flag[runs.parent[i]] |= 2;
+                }
+                if (hasAbove) {
+                    for (size_t i = runs.rowBegin(y, nz - 1); i < runs.rowEnd(y, nz - 1); ++i) flag[runs.parent[i]] |= 2;
+                }
+            }
+            SlabComponents &components = slabComponents[s];
+            for (size_t i = 0; i < runs.numRuns(); ++i) {
+                if (runs.parent[i] != i || !(flag[i] & 2)) continue;
+                components.emplace_back((uint32_t)i, interfaces.add());
+                interfaceOutside.push_back(flag[i] & 1);
+            }
+
+            if (hasBelow) {
+                for (int y = 0; y < numY; ++y) {
+                    size_t a = top.rowStart[y], b = runs.rowBegin(y, 0);
+                    const size_t aEnd = top.rowStart[y + 1], bEnd = runs.rowEnd(y, 0);
+                    while (a < aEnd && b < bEnd) {
+                        if (top.x1[a] < runs.x0[b]) { ++a; continue; }
+                        if (runs.x1[b] < top.x0[a]) { ++b; continue; }
+                        interfaces.unite(top.component[a], InterfaceComponent(components, runs.parent[b]));
+                        if (top.x1[a] < runs.x1[b]) ++a;
+                        else ++b;
+                    }
+                }
+            }
+
+            if (hasAbove) {
+                top.rowStart.assign(1, 0);
+                top.x0.clear();
+                top.x1.clear();
+                top.component.clear();
+                for (int y = 0; y < numY; ++y) {
+                    for (size_t i = runs.rowBegin(y, nz - 1); i < runs.rowEnd(y, nz - 1); ++i) {
+                        top.x0.push_back(runs.x0[i]);
+                        top.x1.push_back(runs.x1[i]);
+                        top.component.push_back(InterfaceComponent(components, runs.parent[i]));
+                    }
+                    top.rowStart.push_back(top.x0.size());
+                }
+            }
+            if (stats && stats->progress) stats->progress("stream label", s + 1, numSlabs);
+        }
+
+        for (uint32_t c = 0; c < interfaces.parent.size(); ++c) {
+            interfaceOutside[interfaces.find(c)] |= interfaceOutside[c];
+        }
+
+        // 2. Final labels, slab by slab
+        for (int s = 0; s < numSlabs; ++s) {
+            prepare(s);
+            {
+                voxTimer timer(stats, "outside");
+                for (const auto &component : slabComponents[s]) {
+                    flag[component.first] |= interfaceOutside[interfaces.find(component.second)];
+                }
+                MarkOutsideRuns(runs, flag, slab);
+            }
+            if (stats) {
+                size_t count = 0;
+                for (const uint64_t *w = slab.surfaceRow(0, 0); w != slab.surfaceRow(0, slab.dim[2]); ++w) {
+                    count += __builtin_popcountll(*w);
+                }
+                stats->surfaceVoxels += count;
+            }
+            sink(static_cast<const voxGrid&>(slab), s * depth);
+            if (stats && stats->progress) stats->progress("stream write", s + 1, numSlabs);
+        }
+
+        if (!options.verbose) return;
+        std::cout << "StreamSlabs: " << numSlabs << " slabs of " << depth << " layers, "
+                  << interfaces.parent.size() << " interface components" << std::endl;
+    }
+
+    // Voxelizes all parts of an assembly into one material grid fitted around
+    // the whole assembly, in a single pass over Z slabs. Each slab task takes
+    // the parts that reach its slab in order of priority, rasterizes a part's
+    // triangles and adds its inside by ray parity along X, then gives the
+    // claimed voxels the part's material. X rays stay within one Z layer, so
+    // a slab needs only its own bin of triangles. Parts should be closed; a
+    // ray that crosses a part an odd number of times counts as open and keeps
+    // only the part's surface voxels.
+    static void ConvertAssembly(const voxAssembly &assembly, materialGrid &grid, const voxOptions &options){
+        voxStats *stats = options.stats;
+        {
+            voxTimer timer(stats, "grid");
+            const voxEstimate estimate = FitGrid(assembly, grid, options, GridKind::Material);
+            if (options.verbose) estimate.print(std::cout);
+            grid.allocate();
+            if (stats) {
+                stats->triangles = assembly.size();
+                stats->voxels = grid.numVoxels();
+            }
+        }
+
+        voxTimer timer(stats, "surface");
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        voxGrid frame;
+        std::copy(grid.dim, grid.dim + 3, frame.dim);
+        std::copy(grid.origin, grid.origin + 3, frame.origin);
+        std::copy(grid.spacing, grid.spacing + 3, frame.spacing);
+        frame.wordsPerRow = (numX + 63) / 64;
+        const int wordsPerRow = frame.wordsPerRow;
+
+        SlabBins bins;
+        BinTrianglesBySlab(assembly, frame, options.slabDepth > 0 ? options.slabDepth : DefaultSlabDepth(numZ), bins);
+        const uint32_t *indices = bins.indices.data();
+
+        size_t tests = 0, hits = 0, crossings = 0, openRays = 0, slabsDone = 0;
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:tests, hits, crossings, openRays)
+#endif
+        {
+            // Voxels claimed by the current part, one bit each, as slab rows.
+            std::vector<uint64_t> claim((size_t)wordsPerRow * numY * bins.depth);
+            std::vector<voxParity::Crossing> rayHits;
+            std::vector<voxParity::Span> spans;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+            for (int b = 0; b < bins.numSlabs; ++b) {
+                const int z0 = b * bins.depth;
+                const int z1 = std::min(numZ - 1, z0 + bins.depth - 1);
+                auto claimRow = [&](int y, int z) { return claim.data() + ((size_t)(z - z0) * numY + y) * wordsPerRow; };
+
+                // Bin entries are in triangle order, so each part is one run.
+                for (size_t first = bins.offsets[b], last; first < bins.offsets[b + 1]; first = last) {
+                    const size_t part = assembly.partOf(indices[first]);
+                    last = std::lower_bound(indices + first, indices + bins.offsets[b + 1],
+                                            assembly.offsets[part + 1]) - indices;
+
+                    // Voxel box of the part within the slab.
+                    int lo[3] = { numX, numY, z1 + 1 }, hi[3] = { -1, -1, -1 };
+                    for (size_t i = first; i < last; ++i) {
+                        int tlo[3], thi[3];
+                        TriangleVoxelRange(assembly, indices[i], grid.origin, grid.spacing, grid.dim, tlo, thi);
+                        for (int k = 0; k < 3; ++k) {
+                            lo[k] = std::min(lo[k], tlo[k]);
+                            hi[k] = std::max(hi[k], thi[k]);
+                        }
+                    }
+                    lo[2] = std::max(lo[2], z0);
+                    hi[2] = std::min(hi[2], z1);
+                    if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2]) continue;
+                    const int w0 = lo[0] >> 6, w1 = hi[0] >> 6;
+                    for (int z = lo[2]; z <= hi[2]; ++z) {
+                        for (int y = lo[1]; y <= hi[1]; ++y) std::fill(claimRow(y, z) + w0, claimRow(y, z) + w1 + 1, 0);
+                    }
+
+                    RasterCounters counters;
+                    RasterizeBin(assembly, frame, bins, b, first, last, options.precision,
+                                 [&](int y, int z, int w, uint64_t mask) { claimRow(y, z)[w] |= mask; },
+                                 stats ? &counters : nullptr);
+                    tests += counters.tests;
+                    hits += counters.hits;
+
+                    for (int z = lo[2]; z <= hi[2]; ++z) {
+                        voxParity::RowCrossings(assembly, frame, 0, 2, z, indices + first, indices + last, rayHits);
+                        crossings += rayHits.size();
+                        openRays += voxParity::RowSpans(rayHits, spans);
+                        for (const voxParity::Span &span : spans) bitRow::SetRange(claimRow(span.u, z), span.k0, span.k1);
+                    }
+
+                    // Claimed voxels go to this part, over the parts before it.
+                    const uint16_t material = assembly.materials[part];
+                    for (int z = lo[2]; z <= hi[2]; ++z) {
+                        for (int y = lo[1]; y <= hi[1]; ++y) {
+                            const uint64_t *row = claimRow(y, z);
+                            uint16_t *dst = grid.labels.data() + grid.index(0, y, z);
+                            for (int w = w0; w <= w1; ++w) {
+                                for (uint64_t bits = row[w]; bits; ) {
+                                    const int start = __builtin_ctzll(bits);
+                                    const uint64_t rest = ~(bits >> start);
+                                    const int length = rest ? __builtin_ctzll(rest) : 64 - start;
+                                    std::fill_n(dst + w * 64 + start, length, material);
+                                    bits &= length + start == 64 ? ~(~uint64_t(0) << start) : ~(((uint64_t(1) << length) - 1) << start);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                if (stats && stats->progress) {
+                    size_t done;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+                    done = ++slabsDone;
+#ifdef _OPENMP
+#pragma omp critical(stl2vox_progress)
+#endif
+                    stats->progress("assembly", done, (size_t)bins.numSlabs);
+                }
+            }
+        }
+
+        AddCounters(stats, {tests, hits});
+        if (stats) {
+            stats->rayCrossings += crossings;
+            stats->openRays += openRays;
+        }
+        if (!options.verbose) return;
+        std::cout << "ConvertAssembly: " << assembly.numParts() << " parts, " << assembly.size() << " triangles in "
+                  << bins.numSlabs << " slabs, " << crossings << " crossings, " << openRays << " open rays" << std::endl;
     }
 };
 
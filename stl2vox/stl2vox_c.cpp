@@ -0,0 +1,258 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+// The stl2vox shared library: the C interface of stl2vox_c.h over the
+// header-only voxelizer.
+
+#include "stl2vox_c.h"
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "meshView.h"
+#include "stlReader.h"
+#include "stl2vox.h"
+#include "voxWriter.h"
+
+struct stl2vox_grid
+{
+    voxGrid grid;
+    voxField distance;
+    std::once_flag labelsOnce;
+    std::vector<int8_t> labels;
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+// Sets the OpenMP thread count of the calling thread for one call.
+class threadScope
+{
+private:
+    int previous = 0;
+
+public:
+    explicit threadScope(int threads){
+#ifdef _OPENMP
+        previous = omp_get_max_threads();
+        if (threads > 0) omp_set_num_threads(threads);
+#else
+        (void)threads;
+#endif
+    }
+
+    ~threadScope(){
+#ifdef _OPENMP
+        omp_set_num_threads(previous);
+#endif
+    }
+};
+
+voxOptions ToOptions(const stl2vox_params *params){
+    if (params == nullptr) throw std::runtime_error("Missing parameters");
+    voxOptions options;
+    for (int k = 0; k < 3; ++k) {
+        if (params->dim[k] <= 0) throw std::runtime_error("Grid dimensions must be positive");
+        options.dim[k] = params->dim[k];
+    }
+    if (params->fill != STL2VOX_FILL_FLOOD && params->fill != STL2VOX_FILL_PARITY) {
+        throw std::runtime_error("Unknown fill mode");
+    }
+    if (params->raster != STL2VOX_RASTER_SLABS && params->raster != STL2VOX_RASTER_TRIANGLES) {
+        throw std::runtime_error("Unknown raster mode");
+    }
+    if (params->precision != STL2VOX_PRECISION_DOUBLE && params->precision != STL2VOX_PRECISION_FLOAT) {
+        throw std::runtime_error("Unknown precision");
+    }
+    if (params->sdf_band < 0) throw std::runtime_error("The distance band must not be negative");
+    options.fill = params->fill == STL2VOX_FILL_PARITY ? FillMode::Parity : FillMode::Flood;
+    options.raster = params->raster == STL2VOX_RASTER_TRIANGLES ? RasterMode::Triangles : RasterMode::Slabs;
+    options.precision = params->precision == STL2VOX_PRECISION_FLOAT ? Precision::Float : Precision::Double;
+    options.sdfBand = params->sdf_band;
+    if (params->morph != nullptr) options.morph = voxOptions::ParseMorph(params->morph);
+    if (options.sdfBand > 0 && !options.morph.empty()) {
+        throw std::runtime_error("Signed distances are measured from the voxelized surface, without morph");
+    }
+    options.verbose = false;
+    return options;
+}
+
+template<typename Mesh>
+void Voxelize(const Mesh &mesh, const voxOptions &options, stl2vox_grid &result){
+    stl2vox::Convert(mesh, result.grid, options);
+    if (options.sdfBand > 0) stl2vox::DistanceStage(mesh, result.grid, options, result.distance);
+    stl2vox::MorphologyStage(result.grid, options);
+}
+
+// Runs load(options, result) and hands the grid over, or records the error.
+template<typename Load>
+int Run(const stl2vox_params *params, stl2vox_grid **grid, Load &&load){
+    try {
+        if (grid == nullptr) throw std::runtime_error("Missing grid pointer");
+        *grid = nullptr;
+        const voxOptions options = ToOptions(params);
+        threadScope threads(params->threads);
+        std::unique_ptr<stl2vox_grid> result(new stl2vox_grid);
+        load(options, *result);
+        *grid = result.release();
+        return 0;
+    } catch (const std::exception &e) {
+        lastError = e.what();
+        return -1;
+    }
+}
+
+template<typename Real>
+int VoxelizeMesh(const Real *vertices, size_t numVertices, const uint32_t *indices, size_t numTriangles,
+                 const stl2vox_params *params, stl2vox_grid **grid){
+    return Run(params, grid, [&](const voxOptions &options, stl2vox_grid &result) {
+        const meshView<Real> mesh(vertices, numVertices, indices, numTriangles);
+        mesh.check();
+        Voxelize(mesh, options, result);
+    });
+}
+
+}
+
+extern "C" {
+
+void stl2vox_params_init(stl2vox_params *params){
+    if (params == nullptr) return;
+    params->dim[0] = params->dim[1] = params->dim[2] = 0;
+    params->fill = STL2VOX_FILL_FLOOD;
+    params->raster = STL2VOX_RASTER_SLABS;
+    params->sdf_band = 0;
+    params->threads = 0;
+    params->precision = STL2VOX_PRECISION_DOUBLE;
+    params->morph = nullptr;
+}
+
+int stl2vox_voxelize_mesh_f32(const float *vertices, size_t num_vertices, const uint32_t *indices,
+                              size_t num_triangles, const stl2vox_params *params, stl2vox_grid **grid){
+    return VoxelizeMesh(vertices, num_vertices, indices, num_triangles, params, grid);
+}
+
+int stl2vox_voxelize_mesh_f64(const double *vertices, size_t num_vertices, const uint32_t *indices,
+                              size_t num_triangles, const stl2vox_params *params, stl2vox_grid **grid){
+    return VoxelizeMesh(vertices, num_vertices, indices, num_triangles, params, grid);
+}
+
+int stl2vox_voxelize_stl(const void *data, size_t size, const stl2vox_params *params, stl2vox_grid **grid){
+    return Run(params, grid, [&](const voxOptions &options, stl2vox_grid &result) {
+        if (data == nullptr) throw std::runtime_error("Missing STL data");
+        STLMesh mesh;
+        stlReader::ReadStlBuffer(static_cast<const char*>(data), size, mesh);
+        Voxelize(mesh, options, result);
+    });
+}
+
+int stl2vox_grid_morph(const stl2vox_grid *grid, const char *steps, stl2vox_grid **result){
+    try {
+        if (result == nullptr) throw std::runtime_error("Missing grid pointer");
+        *result = nullptr;
+        if (grid == nullptr || steps == nullptr) throw std::runtime_error("Missing grid or steps");
+        const std::vector<morphStep> parsed = voxOptions::ParseMorph(steps);
+        std::unique_ptr<stl2vox_grid> copy(new stl2vox_grid);
+        voxGrid &target = copy->grid;
+        std::copy(grid->grid.dim, grid->grid.dim + 3, target.dim);
+        std::copy(grid->grid.origin, grid->grid.origin + 3, target.origin);
+        std::copy(grid->grid.spacing, grid->grid.spacing + 3, target.spacing);
+        target.allocate();
+        std::copy(grid->grid.surface.begin(), grid->grid.surface.end(), target.surface.begin());
+        std::copy(grid->grid.outside.begin(), grid->grid.outside.end(), target.outside.begin());
+        voxMorphology::Apply(target, parsed);
+        *result = copy.release();
+        return 0;
+    } catch (const std::exception &e) {
+        lastError = e.what();
+        return -1;
+    }
+}
+
+void stl2vox_grid_free(stl2vox_grid *grid){
+    delete grid;
+}
+
+void stl2vox_grid_get_info(const stl2vox_grid *grid, stl2vox_grid_info *info){
+    if (grid == nullptr || info == nullptr) return;
+    for (int k = 0; k < 3; ++k) {
+        info->dim[k] = grid->grid.dim[k];
+        info->origin[k] = grid->grid.origin[k];
+        info->spacing[k] = grid->grid.spacing[k];
+    }
+    info->words_per_row = (size_t)grid->grid.wordsPerRow;
+    info->has_distance = grid->distance.values.empty() ? 0 : 1;
+}
+
+int stl2vox_grid_copy_labels(const stl2vox_grid *grid, int8_t *out, size_t size){
+    if (grid == nullptr || out == nullptr || size < grid->grid.numVoxels()) {
+        lastError = "The label buffer is missing or too small";
+        return -1;
+    }
+    voxWriter::ExtractLabels(grid->grid, 0, grid->grid.dim[2], out);
+    return 0;
+}
+
+const int8_t *stl2vox_grid_labels(stl2vox_grid *grid){
+    if (grid == nullptr) return nullptr;
+    try {
+        std::call_once(grid->labelsOnce, [grid] {
+            grid->labels.resize(grid->grid.numVoxels());
+            voxWriter::ExtractLabels(grid->grid, 0, grid->grid.dim[2], grid->labels.data());
+        });
+    } catch (const std::exception &e) {
+        lastError = e.what();
+        return nullptr;
+    }
+    return grid->labels.data();
+}
+
+const uint64_t *stl2vox_grid_surface_bits(const stl2vox_grid *grid){
+    return grid ? grid->grid.surface.data() : nullptr;
+}
+
+const uint64_t *stl2vox_grid_outside_bits(const stl2vox_grid *grid){
+    return grid ? grid->grid.outside.data() : nullptr;
+}
+
+const float *stl2vox_grid_distance(const stl2vox_grid *grid){
+    return grid && !grid->distance.values.empty() ? grid->distance.values.data() : nullptr;
+}
+
+const char *stl2vox_last_error(void){
+    return lastError.c_str();
+}
+
+}
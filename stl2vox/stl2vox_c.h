@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+/* C interface of the voxelizer, built as the stl2vox shared library. It takes
+ * a mesh from memory (vertex and index buffers, or the bytes of an STL file)
+ * and returns a grid handle whose contents can be copied into a buffer the
+ * caller owns, or read in place through borrowed pointers that stay valid
+ * until the handle is freed. Functions that can fail return 0 on success and
+ * -1 on failure, with the message in stl2vox_last_error(). */
+
+#ifndef __STL2VOX_C_H__
+#define __STL2VOX_C_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  ifdef STL2VOX_BUILDING_LIBRARY
+#    define STL2VOX_API __declspec(dllexport)
+#  else
+#    define STL2VOX_API __declspec(dllimport)
+#  endif
+#else
+#  define STL2VOX_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum { STL2VOX_FILL_FLOOD = 0, STL2VOX_FILL_PARITY = 1 };
+enum { STL2VOX_RASTER_SLABS = 0, STL2VOX_RASTER_TRIANGLES = 1 };
+enum { STL2VOX_PRECISION_DOUBLE = 0, STL2VOX_PRECISION_FLOAT = 1 };
+
+/* Grid parameters, see voxOptions. Start from stl2vox_params_init. */
+typedef struct stl2vox_params {
+    int dim[3];         /* voxels per axis, required */
+    int fill;           /* STL2VOX_FILL_* */
+    int raster;         /* STL2VOX_RASTER_* */
+    int sdf_band;       /* > 0 also computes signed distances, exact within this many voxels */
+    int threads;        /* OpenMP threads for the call, 0 for the default */
+    int precision;      /* STL2VOX_PRECISION_*, of the per-voxel triangle tests */
+    const char *morph;  /* NULL, or morphology steps applied to the grid as for --morph, e.g.
+                           "close:2:sphere,shell:3"; the grid is widened so dilations fit;
+                           not together with sdf_band */
+} stl2vox_params;
+
+typedef struct stl2vox_grid_info {
+    int dim[3];
+    double origin[3];       /* corner of voxel (0, 0, 0) */
+    double spacing[3];
+    size_t words_per_row;   /* 64-bit words per X row of the bit planes */
+    int has_distance;
+} stl2vox_grid_info;
+
+typedef struct stl2vox_grid stl2vox_grid;
+
+STL2VOX_API void stl2vox_params_init(stl2vox_params *params);
+
+/* Voxelizes num_triangles triangles given as three indices each into
+ * num_vertices interleaved x, y, z positions. The buffers are only read
+ * during the call. */
+STL2VOX_API int stl2vox_voxelize_mesh_f32(const float *vertices, size_t num_vertices, const uint32_t *indices,
+                                          size_t num_triangles, const stl2vox_params *params, stl2vox_grid **grid);
+STL2VOX_API int stl2vox_voxelize_mesh_f64(const double *vertices, size_t num_vertices, const uint32_t *indices,
+                                          size_t num_triangles, const stl2vox_params *params, stl2vox_grid **grid);
+
+/* Voxelizes a binary or ASCII STL file held in memory. */
+STL2VOX_API int stl2vox_voxelize_stl(const void *data, size_t size, const stl2vox_params *params,
+                                     stl2vox_grid **grid);
+
+/* Applies morphology steps (as in stl2vox_params.morph) to a copy of grid,
+ * which is left unchanged, without its distances. Voxels beyond the grid
+ * count as empty, so dilations are clipped at the grid boundary. */
+STL2VOX_API int stl2vox_grid_morph(const stl2vox_grid *grid, const char *steps, stl2vox_grid **result);
+
+STL2VOX_API void stl2vox_grid_free(stl2vox_grid *grid);
+
+STL2VOX_API void stl2vox_grid_get_info(const stl2vox_grid *grid, stl2vox_grid_info *info);
+
+/* Copies one label per voxel (-1 outside, 0 surface, 1 inside; X fastest)
+ * into out, which must hold at least dim[0] * dim[1] * dim[2] bytes. */
+STL2VOX_API int stl2vox_grid_copy_labels(const stl2vox_grid *grid, int8_t *out, size_t size);
+
+/* Borrowed views, valid until stl2vox_grid_free. The labels are laid out as
+ * above and are extracted on the first call. The two bit planes are the
+ * grid's own storage: bit x of word x / 64 in row (y, z), rows of
+ * words_per_row words in Y then Z order, bits past dim[0] unspecified. A
+ * voxel is surface if its surface bit is set, else outside if its outside
+ * bit is set, else inside. The distances are one float32 per voxel, negative
+ * inside, or NULL without sdf_band. */
+STL2VOX_API const int8_t *stl2vox_grid_labels(stl2vox_grid *grid);
+STL2VOX_API const uint64_t *stl2vox_grid_surface_bits(const stl2vox_grid *grid);
+STL2VOX_API const uint64_t *stl2vox_grid_outside_bits(const stl2vox_grid *grid);
+STL2VOX_API const float *stl2vox_grid_distance(const stl2vox_grid *grid);
+
+/* Message of the last failure on the calling thread. */
+STL2VOX_API const char *stl2vox_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
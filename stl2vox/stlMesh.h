@@ -29,6 +29,7 @@
 #ifndef __STLMESH_H__
 #define __STLMESH_H__
 
+#include <cstddef>
 #include <vector>
 
 #include "vector3d.h"
@@ -65,6 +66,19 @@ struct STLMesh
 {   
     int numTriangles;
     std::vector<Triangle> triangleList;
+
+    // Accessors shared with IndexedMesh, so the voxelizer accepts either mesh.
+    size_t size() const { return triangleList.size(); }
+    const Triangle& triangle(size_t t) const { return triangleList[t]; }
+    void bounds(size_t t, double lo[3], double hi[3]) const {
+        const Vector3d minTri = triangleList[t].min();
+        const Vector3d maxTri = triangleList[t].max();
+        lo[0] = minTri.x; lo[1] = minTri.y; lo[2] = minTri.z;
+        hi[0] = maxTri.x; hi[1] = maxTri.y; hi[2] = maxTri.z;
+    }
+
+    size_t memoryBytes() const { return triangleList.capacity() * sizeof(Triangle); }
+
     ~STLMesh() {
         triangleList.clear();
         triangleList.shrink_to_fit();
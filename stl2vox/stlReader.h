@@ -29,11 +29,24 @@
 #ifndef __STLREADER_H__
 #define __STLREADER_H__
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <vector>
-#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "stlMesh.h"
+#include "indexedMesh.h"
+#include "mappedFile.h"
+#include "voxHash.h"
 
 class stlReader
 {
@@ -88,39 +101,206 @@ private:
         std::cout << "X : Y : Z = " << rateX << " : " << rateY << " : " << rateZ << std::endl;
     };
 
-public:
-    static void ReadStlFile(const std::string& filename, STLMesh &stlmesh){
-        std::ifstream file(filename, std::ios::binary);
-        if(!file.is_open()){
-            throw std::runtime_error("Failed to open file");
+    static bool IsBinaryStl(const char *data, size_t size){
+        if(size < 84) return false;
+        uint32_t num_triangles;
+        std::memcpy(&num_triangles, data + 80, sizeof(num_triangles));
+        return size == 84 + (size_t)num_triangles * 50;
+    }
+
+    static bool IsAsciiStl(const char *data, size_t size){
+        size_t i = 0;
+        while(i < size && std::isspace((unsigned char)data[i])) ++i;
+        return size - i >= 5 && std::strncmp(data + i, "solid", 5) == 0;
+    }
+
+    // Binary layout: 80-byte header, uint32 count, then 50-byte records of
+    // normal[3], v0[3], v1[3], v2[3] (float32) and a 2-byte attribute.
+    static void DecodeBinaryStl(const char *data, size_t size, STLMesh &stlmesh){
+        uint32_t num_triangles;
+        std::memcpy(&num_triangles, data + 80, sizeof(num_triangles));
+        if(size != 84 + (size_t)num_triangles * 50){
+            throw std::runtime_error("Binary STL size does not match its triangle count");
+        }
+
+        stlmesh.numTriangles = (int)num_triangles;
+        stlmesh.triangleList.resize(num_triangles);
+
+        const char *records = data + 84;
+        const long long count = (long long)num_triangles;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 4096)
+#endif
+        for(long long i = 0; i < count; ++i) {
+            float f[12];
+            std::memcpy(f, records + (size_t)i * 50, sizeof(f));
+
+            Triangle &tri = stlmesh.triangleList[i];
+            tri.normal = Vector3d(f[0], f[1], f[2]);
+            tri.v0 = Vector3d(f[3], f[4], f[5]);
+            tri.v1 = Vector3d(f[6], f[7], f[8]);
+            tri.v2 = Vector3d(f[9], f[10], f[11]);
+        }
+    }
+
+    static const char* SkipSpace(const char *p, const char *end){
+        while(p < end && std::isspace((unsigned char)*p)) ++p;
+        return p;
+    }
+
+    static const char* ExpectWord(const char *p, const char *end, const char *word){
+        p = SkipSpace(p, end);
+        size_t n = std::strlen(word);
+        if((size_t)(end - p) < n || std::strncmp(p, word, n) != 0){
+            throw std::runtime_error(std::string("Malformed ASCII STL: expected '") + word + "'");
         }
+        return p + n;
+    }
 
-        file.seekg(80);
-        int num_triangles;
-        file.read(reinterpret_cast<char*>(&num_triangles), sizeof(num_triangles));
-        stlmesh.numTriangles = num_triangles;
-        stlmesh.triangleList.reserve(num_triangles);
+    static const char* ParseVector(const char *p, const char *end, Vector3d &v){
+        double c[3];
+        for(int k = 0; k < 3; ++k){
+            p = SkipSpace(p, end);
+            if(p < end && *p == '+') ++p;
+            auto res = std::from_chars(p, end, c[k]);
+            if(res.ec != std::errc()){
+                throw std::runtime_error("Malformed ASCII STL: invalid number");
+            }
+            p = res.ptr;
+        }
+        v = Vector3d(c[0], c[1], c[2]);
+        return p;
+    }
+
+    static void ParseAsciiStl(const char *data, size_t size, STLMesh &stlmesh){
+        const char *p = data;
+        const char *end = data + size;
+        stlmesh.triangleList.clear();
+
+        while(true){
+            // Keywords between facets ("solid name", "endsolid name") are skipped
+            // by searching for the next facet record.
+            const char *facet = nullptr;
+            for(const char *q = p; q + 5 <= end; ++q){
+                if(*q == 'f' && std::strncmp(q, "facet", 5) == 0 && (q == data || std::isspace((unsigned char)q[-1]))){
+                    facet = q;
+                    break;
+                }
+            }
+            if(facet == nullptr) break;
 
-        for(int i = 0; i < num_triangles; ++i) {
             Triangle tri;
-            float normal[3], v0[3], v1[3], v2[3];
-            file.read(reinterpret_cast<char*>(normal), 3 * sizeof(float));
-            file.read(reinterpret_cast<char*>(v0), 3 * sizeof(float));
-            file.read(reinterpret_cast<char*>(v1), 3 * sizeof(float));
-            file.read(reinterpret_cast<char*>(v2), 3 * sizeof(float));
-            file.ignore(2);
-
-            tri.normal = Vector3d(normal[0], normal[1], normal[2]);
-            tri.v0 = Vector3d(v0[0], v0[1], v0[2]);
-            tri.v1 = Vector3d(v1[0], v1[1], v1[2]);
-            tri.v2 = Vector3d(v2[0], v2[1], v2[2]);
+            p = ExpectWord(facet + 5, end, "normal");
+            p = ParseVector(p, end, tri.normal);
+            p = ExpectWord(p, end, "outer");
+            p = ExpectWord(p, end, "loop");
+            p = ExpectWord(p, end, "vertex");
+            p = ParseVector(p, end, tri.v0);
+            p = ExpectWord(p, end, "vertex");
+            p = ParseVector(p, end, tri.v1);
+            p = ExpectWord(p, end, "vertex");
+            p = ParseVector(p, end, tri.v2);
+            p = ExpectWord(p, end, "endloop");
+            p = ExpectWord(p, end, "endfacet");
             stlmesh.triangleList.push_back(tri);
         }
 
-        std::cout << "Already Read " << num_triangles << " triangles from " << filename << std::endl;
+        stlmesh.numTriangles = (int)stlmesh.triangleList.size();
+    }
+
+public:
+    // Decodes an in-memory STL image, binary or ASCII.
+    static void ReadStlBuffer(const char *data, size_t size, STLMesh &stlmesh){
+        if(IsBinaryStl(data, size)){
+            DecodeBinaryStl(data, size, stlmesh);
+        }else if(IsAsciiStl(data, size)){
+            ParseAsciiStl(data, size, stlmesh);
+        }else if(size >= 84){
+            throw std::runtime_error("Binary STL size does not match its triangle count");
+        }else{
+            throw std::runtime_error("File is too small to be an STL file");
+        }
+
+        if(stlmesh.triangleList.empty()){
+            throw std::runtime_error("STL file contains no triangles");
+        }
+    }
+
+    static void ReadStlFile(const std::string& filename, STLMesh &stlmesh, bool verbose = true){
+        mappedFile file(filename);
+        ReadStlBuffer(file.data(), file.size(), stlmesh);
+        if(!verbose) return;
+
+        std::cout << "Already Read " << stlmesh.numTriangles << " triangles from " << filename << std::endl;
 
         OutputStlInfo(stlmesh);
     }
+
+    // Reads into a welded IndexedMesh. Binary STL coordinates are float32 and
+    // are kept exactly; ASCII coordinates are rounded to float32.
+    static void ReadStlBuffer(const char *data, size_t size, IndexedMesh &mesh){
+        if(IsBinaryStl(data, size)){
+            const size_t numTriangles = (size - 84) / 50;
+            meshWelder::Weld(numTriangles, [&](size_t t, int c, float p[3]) {
+                std::memcpy(p, data + 84 + t * 50 + 12 + 12 * c, 3 * sizeof(float));
+            }, mesh);
+        }else{
+            STLMesh stlmesh;
+            ReadStlBuffer(data, size, stlmesh);
+            meshWelder::Weld(stlmesh.size(), [&](size_t t, int c, float p[3]) {
+                const Triangle &tri = stlmesh.triangleList[t];
+                const Vector3d &v = c == 0 ? tri.v0 : (c == 1 ? tri.v1 : tri.v2);
+                p[0] = (float)v.x;
+                p[1] = (float)v.y;
+                p[2] = (float)v.z;
+            }, mesh);
+        }
+
+        if(mesh.size() == 0){
+            throw std::runtime_error("STL file contains no triangles");
+        }
+    }
+
+    static void ReadStlFile(const std::string& filename, IndexedMesh &mesh, bool verbose = true){
+        mappedFile file(filename);
+        ReadStlBuffer(file.data(), file.size(), mesh);
+        if(!verbose) return;
+
+        std::cout << "Already Read " << mesh.size() << " triangles with " << mesh.numVertices()
+                  << " distinct vertices from " << filename << " ("
+                  << mesh.memoryBytes() / (1024.0 * 1024.0) << " MiB)" << std::endl;
+    }
+
+    // Hash of what a voxelization depends on, computed without decoding: the
+    // vertex coordinates of a binary STL (normals and attribute bytes are
+    // skipped) or the whole text of an ASCII STL. Chunks are hashed in
+    // parallel and combined in order.
+    static uint64_t PayloadHash(const char *data, size_t size){
+        const bool binary = IsBinaryStl(data, size);
+        const uint64_t items = binary ? (size - 84) / 50 : size;
+        const uint64_t chunk = binary ? 65536 : (uint64_t(4) << 20);
+        const long long numChunks = (long long)((items + chunk - 1) / chunk);
+
+        std::vector<uint64_t> hashes(numChunks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long c = 0; c < numChunks; ++c){
+            const uint64_t begin = c * chunk;
+            const uint64_t end = std::min(items, begin + chunk);
+            uint64_t h = 0;
+            if(binary){
+                for(uint64_t r = begin; r < end; ++r) h = voxHash::Bytes(data + 84 + r * 50 + 12, 36, h);
+            }else{
+                h = voxHash::Bytes(data + begin, end - begin);
+            }
+            hashes[c] = h;
+        }
+
+        uint64_t h = voxHash::Bytes(&items, sizeof(items), binary ? 1 : 0);
+        for(uint64_t chunkHash : hashes) h = voxHash::Combine(h, chunkHash);
+        return h;
+    }
 };
 
 
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks.
+class threadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    size_t running = 0;
+    bool stopping = false;
+
+    void WorkerLoop(){
+        while(true){
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskReady.wait(lock, [&] { return stopping || !tasks.empty(); });
+                if(tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                ++running;
+            }
+
+            task();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+            if(tasks.empty() && running == 0) allDone.notify_all();
+        }
+    }
+
+public:
+    explicit threadPool(int numThreads){
+        if(numThreads < 1) numThreads = 1;
+        for(int i = 0; i < numThreads; ++i){
+            workers.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    threadPool(const threadPool&) = delete;
+    threadPool& operator=(const threadPool&) = delete;
+
+    // Finishes the queued tasks, then joins the workers.
+    ~threadPool(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for(auto &worker : workers) worker.join();
+    }
+
+    // Tasks must not throw; catch inside the task and report from there.
+    void submit(std::function<void()> task){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        taskReady.notify_one();
+    }
+
+    // Blocks until the queue is empty and no task is running.
+    void wait(){
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [&] { return tasks.empty() && running == 0; });
+    }
+
+    int size() const { return (int)workers.size(); }
+};
+
+#endif
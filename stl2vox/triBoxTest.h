@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TRIBOXTEST_H__
+#define __TRIBOXTEST_H__
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "stlMesh.h"
+
+// Separating-axis triangle/box overlap test (Akenine-Moller) specialised for a
+// regular grid. Everything that depends only on the triangle and the voxel
+// size is computed once in the constructor; testing a voxel then reduces to
+// comparing one linear function of the voxel centre per axis.
+struct TriBoxTest
+{
+    // 3 box normals, the triangle normal and the 9 edge/box-normal cross products.
+    static const int numAxes = 13;
+
+    double axis[numAxes][3];
+    double lo[numAxes];     // min projection of the triangle minus the box radius
+    double hi[numAxes];     // max projection of the triangle plus the box radius
+
+    double origin[3];
+    double spacing[3];
+
+    // Box normals, and the corners (head, tail) of the three triangle edges.
+    static constexpr Vector3d boxAxes[3] = { Vector3d(1, 0, 0), Vector3d(0, 1, 0), Vector3d(0, 0, 1) };
+    static constexpr int edgeCorners[3][2] = { {1, 0}, {2, 1}, {0, 2} };
+
+    TriBoxTest(const Triangle &triangle, const double gridOrigin[3], const double gridSpacing[3]){
+        const Vector3d v[3] = { triangle.v0, triangle.v1, triangle.v2 };
+        Vector3d edge[3];
+        for(int i = 0; i < 3; ++i) edge[i] = v[edgeCorners[i][0]] - v[edgeCorners[i][1]];
+
+        for(int k = 0; k < 3; ++k){
+            origin[k] = gridOrigin[k];
+            spacing[k] = gridSpacing[k];
+        }
+
+        int n = 0;
+        for(int k = 0; k < 3; ++k) SetAxis(n++, boxAxes[k], v);
+        SetAxis(n++, edge[0].cross(edge[1]), v);
+        for(int i = 0; i < 3; ++i){
+            for(int j = 0; j < 3; ++j){
+                SetAxis(n++, boxAxes[i].cross(edge[j]), v);
+            }
+        }
+    }
+
+    bool Overlaps(int x, int y, int z) const {
+        const double c[3] = {
+            origin[0] + (x + 0.5) * spacing[0],
+            origin[1] + (y + 0.5) * spacing[1],
+            origin[2] + (z + 0.5) * spacing[2]
+        };
+        for(int a = 0; a < numAxes; ++a){
+            double s = axis[a][0] * c[0] + axis[a][1] * c[1] + axis[a][2] * c[2];
+            if(s < lo[a] || s > hi[a]) return false;
+        }
+        return true;
+    }
+
+    // Narrows the rows y0 .. y1 of layer z, for voxels x0 .. x1, to those that
+    // can overlap the triangle: along each axis the row centre must be within
+    // reach of the triangle's projection from some x in the range. Returns
+    // false if no row can.
+    bool LayerRows(int z, int x0, int x1, int &y0, int &y1) const {
+        const double cz = origin[2] + (z + 0.5) * spacing[2];
+        const double cx0 = origin[0] + (x0 + 0.5) * spacing[0];
+        const double cx1 = origin[0] + (x1 + 0.5) * spacing[0];
+        double yLo = -INFINITY, yHi = INFINITY;
+        for(int a = 0; a < numAxes; ++a){
+            const double s = axis[a][2] * cz;
+            const double sx0 = axis[a][0] * cx0, sx1 = axis[a][0] * cx1;
+            const double l = lo[a] - s - std::max(sx0, sx1);
+            const double h = hi[a] - s - std::min(sx0, sx1);
+            if(!Clip(axis[a][1], l, h, yLo, yHi)) return false;
+        }
+        return Narrow(yLo, yHi, 1, y0, y1);
+    }
+
+    // Narrows x0 .. x1 to the voxels of row (y, z) that can overlap the
+    // triangle. Each axis bounds the centre's x to an interval and the
+    // overlapping voxels of a row are their intersection, so the result is
+    // only widened for rounding. Returns false if no voxel can.
+    bool RowRange(int y, int z, int &x0, int &x1) const {
+        const double cy = origin[1] + (y + 0.5) * spacing[1];
+        const double cz = origin[2] + (z + 0.5) * spacing[2];
+        double xLo = -INFINITY, xHi = INFINITY;
+        for(int a = 0; a < numAxes; ++a){
+            const double s = axis[a][1] * cy + axis[a][2] * cz;
+            if(!Clip(axis[a][0], lo[a] - s, hi[a] - s, xLo, xHi)) return false;
+        }
+        return Narrow(xLo, xHi, 0, x0, x1);
+    }
+
+    // Tests voxels x0 .. x0+count-1 (count <= 64) of row (y, z) and returns a mask
+    // with bit k set when voxel x0+k overlaps the triangle. The row is set up
+    // in double relative to voxel x0, so the per-voxel comparisons only span
+    // the 64 voxels of the word and Real = float keeps about the accuracy of
+    // double far from the origin while testing twice as many voxels per
+    // vector instruction.
+    template<typename Real = double>
+    uint64_t RowMask(int y, int z, int x0, int count) const {
+        constexpr int lanes = sizeof(Real) == sizeof(float) ? 16 : 8;
+        const double cy = origin[1] + (y + 0.5) * spacing[1];
+        const double cz = origin[2] + (z + 0.5) * spacing[2];
+        const double cx0 = origin[0] + (x0 + 0.5) * spacing[0];
+
+        Real rowLo[numAxes], rowHi[numAxes], ax[numAxes];
+        for(int a = 0; a < numAxes; ++a){
+            const double s = axis[a][0] * cx0 + axis[a][1] * cy + axis[a][2] * cz;
+            rowLo[a] = (Real)(lo[a] - s);
+            rowHi[a] = (Real)(hi[a] - s);
+            ax[a] = (Real)(axis[a][0] * spacing[0]);
+        }
+
+        uint64_t mask = 0;
+        for(int base = 0; base < count; base += lanes){
+            int hit[lanes];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+            for(int k = 0; k < lanes; ++k){
+                const Real dx = (Real)(base + k);
+                int ok = 1;
+                for(int a = 0; a < numAxes; ++a){
+                    const Real s = ax[a] * dx;
+                    ok &= (s >= rowLo[a]) & (s <= rowHi[a]);
+                }
+                hit[k] = ok;
+            }
+            const int n = std::min(lanes, count - base);
+            for(int k = 0; k < n; ++k){
+                mask |= (uint64_t)hit[k] << (base + k);
+            }
+        }
+        return mask;
+    }
+
+private:
+    // Intersects [tLo, tHi] with the t satisfying l <= c * t <= h. With c = 0
+    // the condition does not depend on t and either holds or empties the range.
+    static bool Clip(double c, double l, double h, double &tLo, double &tHi){
+        if(c == 0) return l <= 0 && h >= 0;
+        if(c > 0){
+            tLo = std::max(tLo, l / c);
+            tHi = std::min(tHi, h / c);
+        } else {
+            tLo = std::max(tLo, h / c);
+            tHi = std::min(tHi, l / c);
+        }
+        return true;
+    }
+
+    // Narrows voxels i0 .. i1 along axis k to the centres in [tLo, tHi],
+    // widened by one voxel on each side so that rounding never drops one.
+    bool Narrow(double tLo, double tHi, int k, int &i0, int &i1) const {
+        const double f0 = std::ceil((tLo - origin[k]) / spacing[k] - 0.5) - 1;
+        const double f1 = std::floor((tHi - origin[k]) / spacing[k] - 0.5) + 1;
+        if(f0 > i1 || f1 < i0 || !(f0 <= f1)) return false;
+        if(f0 > i0) i0 = (int)f0;
+        if(f1 < i1) i1 = (int)f1;
+        return true;
+    }
+
+    void SetAxis(int n, const Vector3d &a, const Vector3d v[3]){
+        axis[n][0] = a.x;
+        axis[n][1] = a.y;
+        axis[n][2] = a.z;
+
+        double p0 = a.x * v[0].x + a.y * v[0].y + a.z * v[0].z;
+        double p1 = a.x * v[1].x + a.y * v[1].y + a.z * v[1].z;
+        double p2 = a.x * v[2].x + a.y * v[2].y + a.z * v[2].z;
+        double r = 0.5 * (std::abs(a.x) * spacing[0] + std::abs(a.y) * spacing[1] + std::abs(a.z) * spacing[2]);
+
+        lo[n] = std::min(p0, std::min(p1, p2)) - r;
+        hi[n] = std::max(p0, std::max(p1, p2)) + r;
+    }
+};
+
+#endif
@@ -30,58 +30,68 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
-struct Vector3d
+// 3-component vector over scalar T. Products, quotients and dot products stay
+// in T, so Vector3d keeps full double precision throughout.
+template<typename T>
+struct Vector3
 {
-    double x, y, z;
-    Vector3d(double x, double y, double z) : x(x), y(y), z(z) {}
-    Vector3d() : x(0), y(0), z(0) {}
-    ~Vector3d() {}
-    int operator[](int i) const {
+    typedef T Scalar;
+
+    T x, y, z;
+    constexpr Vector3(T x, T y, T z) : x(x), y(y), z(z) {}
+    constexpr Vector3() : x(0), y(0), z(0) {}
+
+    template<typename U>
+    explicit constexpr Vector3(const Vector3<U> &other) : x(T(other.x)), y(T(other.y)), z(T(other.z)) {}
+
+    T operator[](int i) const {
         if(i == 0) return x;
         if(i == 1) return y;
         if(i == 2) return z;
-        throw std::runtime_error("Index out of range");
-        exit(1);
+        throw std::out_of_range("Index out of range");
     }
-    Vector3d operator-(const Vector3d& other) const {
-        return Vector3d(x - other.x, y - other.y, z - other.z);
+
+    constexpr Vector3 operator-(const Vector3& other) const {
+        return Vector3(x - other.x, y - other.y, z - other.z);
     }
 
-    Vector3d operator+(const Vector3d& other) const {
-        return Vector3d(x + other.x, y + other.y, z + other.z);
+    constexpr Vector3 operator+(const Vector3& other) const {
+        return Vector3(x + other.x, y + other.y, z + other.z);
     }
 
-    Vector3d operator*(float scalar) const {
-        return Vector3d(x * scalar, y * scalar, z * scalar);
+    constexpr Vector3 operator*(T scalar) const {
+        return Vector3(x * scalar, y * scalar, z * scalar);
     }
-    
-    Vector3d operator/(float scalar) const {
-        return Vector3d(x / scalar, y / scalar, z / scalar);
+
+    constexpr Vector3 operator/(T scalar) const {
+        return Vector3(x / scalar, y / scalar, z / scalar);
     }
 
-    float dot(const Vector3d& other) const {
+    constexpr T dot(const Vector3& other) const {
         return x * other.x + y * other.y + z * other.z;
     }
 
-    Vector3d cross(const Vector3d& other) const {
-        return Vector3d(
+    constexpr Vector3 cross(const Vector3& other) const {
+        return Vector3(
             y * other.z - z * other.y,
             z * other.x - x * other.z,
             x * other.y - y * other.x
         );
     }
 
-    Vector3d max(const Vector3d& other) const {
-        return Vector3d(
+    Vector3 max(const Vector3& other) const {
+        return Vector3(
             std::max(x, other.x),
             std::max(y, other.y),
             std::max(z, other.z)
         );
     }
 
-    Vector3d min(const Vector3d& other) const {
-        return Vector3d(
+    Vector3 min(const Vector3& other) const {
+        return Vector3(
             std::min(x, other.x),
             std::min(y, other.y),
             std::min(z, other.z)
@@ -89,4 +99,7 @@ struct Vector3d
     }
 };
 
-#endif
\ No newline at end of file
+typedef Vector3<double> Vector3d;
+typedef Vector3<float> Vector3f;
+
+#endif
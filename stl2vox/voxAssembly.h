@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXASSEMBLY_H__
+#define __VOXASSEMBLY_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "stlMesh.h"
+#include "voxOptions.h"
+
+// Labels of an assembly: one material ID per voxel, X fastest, 0 where no
+// part is. See stl2vox::ConvertAssembly.
+struct materialGrid
+{
+    double origin[3] = {0, 0, 0};
+    double spacing[3] = {1, 1, 1};
+    int dim[3] = {0, 0, 0};
+    std::vector<uint16_t> labels;
+
+    void allocate(){ labels.assign(numVoxels(), 0); }
+
+    size_t numVoxels() const { return (size_t)dim[0] * dim[1] * dim[2]; }
+
+    size_t index(int x, int y, int z) const { return ((size_t)z * dim[1] + y) * dim[0] + x; }
+
+    uint16_t get(int x, int y, int z) const { return labels[index(x, y, z)]; }
+};
+
+// The parts of an assembly as one triangle list, so that they are binned and
+// rasterized in one pass. Parts are stored in increasing priority: part p owns
+// triangles [offsets[p], offsets[p+1]) and has material materials[p], and a
+// voxel claimed by several parts goes to the last of them.
+struct voxAssembly
+{
+    // One line of an assembly list.
+    struct Entry {
+        uint16_t material;
+        std::string path;
+    };
+
+    STLMesh mesh;
+    std::vector<size_t> offsets = {0};
+    std::vector<uint16_t> materials;
+    std::vector<std::string> names;
+
+    // Mesh accessors, so the voxelizer sees the whole assembly as one mesh.
+    size_t size() const { return mesh.size(); }
+    const Triangle& triangle(size_t t) const { return mesh.triangle(t); }
+    void bounds(size_t t, double lo[3], double hi[3]) const { mesh.bounds(t, lo, hi); }
+    size_t memoryBytes() const { return mesh.memoryBytes(); }
+
+    size_t numParts() const { return materials.size(); }
+
+    // Part that owns triangle t.
+    size_t partOf(size_t t) const {
+        return std::upper_bound(offsets.begin(), offsets.end(), t) - offsets.begin() - 1;
+    }
+
+    // Appends a part with a higher priority than all parts added so far.
+    void add(const STLMesh &part, uint16_t material, const std::string &name){
+        if (mesh.triangleList.size() + part.triangleList.size() > UINT32_MAX) {
+            throw std::runtime_error("Assemblies are limited to 2^32 triangles");
+        }
+        mesh.triangleList.insert(mesh.triangleList.end(), part.triangleList.begin(), part.triangleList.end());
+        mesh.numTriangles = (int)std::min<size_t>(mesh.triangleList.size(), INT32_MAX);
+        offsets.push_back(mesh.triangleList.size());
+        materials.push_back(material);
+        names.push_back(name);
+    }
+
+    // One part per line, "MATERIAL PATH" with MATERIAL in 1..65535; blank
+    // lines and lines starting with '#' are skipped.
+    static std::vector<Entry> ReadList(const std::string &path){
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open assembly list: " + path);
+        }
+        std::vector<Entry> entries;
+        std::string line;
+        for (int number = 1; std::getline(file, line); ++number) {
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#') continue;
+            std::istringstream fields(line.substr(b));
+            long material = 0;
+            std::string rest;
+            fields >> material;
+            std::getline(fields >> std::ws, rest);
+            size_t e = rest.find_last_not_of(" \t\r");
+            if (material < 1 || material > 65535 || e == std::string::npos) {
+                throw std::runtime_error(path + ":" + std::to_string(number) + ": expected MATERIAL PATH with MATERIAL in 1..65535");
+            }
+            entries.push_back({ (uint16_t)material, rest.substr(0, e + 1) });
+        }
+        if (entries.empty()) throw std::runtime_error("Assembly list has no parts: " + path);
+        return entries;
+    }
+
+    // Sorts list entries into increasing priority under rule.
+    static void Order(std::vector<Entry> &entries, OverlapRule rule){
+        switch (rule) {
+            case OverlapRule::Last:
+                break;
+            case OverlapRule::First:
+                std::reverse(entries.begin(), entries.end());
+                break;
+            case OverlapRule::MaxMaterial:
+                std::stable_sort(entries.begin(), entries.end(),
+                                 [](const Entry &a, const Entry &b) { return a.material < b.material; });
+                break;
+            case OverlapRule::MinMaterial:
+                std::stable_sort(entries.begin(), entries.end(),
+                                 [](const Entry &a, const Entry &b) { return a.material > b.material; });
+                break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,572 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXBATCH_H__
+#define __VOXBATCH_H__
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stlReader.h"
+#include "stl2vox.h"
+#include "voxWriter.h"
+#include "voxOptions.h"
+#include "voxStats.h"
+#include "threadPool.h"
+#include "voxCache.h"
+#include "voxPyramid.h"
+
+// Converts many STL files with the read, voxelize and write stages of
+// different files overlapping on one worker pool: while file N is being
+// voxelized, file N+1 is read and file N-1 is written.
+class voxBatch
+{
+private:
+    struct Job {
+        size_t index;
+        std::string input;
+        std::string output;
+        STLMesh mesh;
+        IndexedMesh indexedMesh;
+        voxGrid grid;
+        sparseGrid sparse;
+        voxField distance;
+        voxStats stats;
+        uint64_t cacheKey = 0;
+        bool cached = false;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    static bool UseCache(const voxOptions &options){
+        return !options.cacheDir.empty() && !options.sparse && !options.stream && options.sdfBand == 0 && !options.components &&
+               options.dim[0] > 0 && options.dim[1] > 0 && options.dim[2] > 0 && options.voxelSize == 0 &&
+               !(options.memoryBudget > 0 && options.downgrade);
+    }
+
+    // Looks input up in the result cache by hashing its raw payload, so a hit
+    // skips decoding as well as voxelizing. key is set either way, for
+    // StoreCached after a miss.
+    static bool LoadCached(const std::string &input, const voxOptions &options, voxGrid &grid, uint64_t &key){
+        voxTimer timer(options.stats, "cache");
+        {
+            mappedFile file(input);
+            key = voxCache::Key(stlReader::PayloadHash(file.data(), file.size()), options.dim,
+                                stl2vox::LevelAlignment(options), (int)options.fill, (int)options.precision,
+                                stl2vox::MorphMargin(options), options.indexed);
+        }
+        voxCache cache(options.cacheDir, options.cacheBytes);
+        if (!cache.load(key, grid)) return false;
+        if (options.stats) {
+            ++options.stats->cacheHits;
+            options.stats->voxels = grid.numVoxels();
+        }
+        return true;
+    }
+
+    static void StoreCached(uint64_t key, const voxGrid &grid, const voxOptions &options){
+        voxTimer timer(options.stats, "cache");
+        voxCache cache(options.cacheDir, options.cacheBytes);
+        if (!cache.store(key, grid) && options.verbose) {
+            std::cerr << "Could not add the grid to the cache in " << options.cacheDir << std::endl;
+        }
+    }
+
+    static void SetThreads(int numThreads){
+#ifdef _OPENMP
+        omp_set_num_threads(std::max(1, numThreads));
+#else
+        (void)numThreads;
+#endif
+    }
+
+    static int HardwareThreads(){
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+
+public:
+    static std::string ReplaceExtension(const std::string& path, const std::string& newExt) {
+        size_t slashPos = path.find_last_of("/\\");
+        size_t dotPos = path.find_last_of('.');
+        if (dotPos == std::string::npos || (slashPos != std::string::npos && dotPos < slashPos)) {
+            return path + newExt;
+        }
+        return path.substr(0, dotPos) + newExt;
+    }
+
+    static std::string OutputPath(const std::string &input, const voxOptions &options){
+        std::string output = ReplaceExtension(input, voxWriter::Extension(options.format));
+        if (options.outputDir.empty()) return output;
+
+        size_t slashPos = output.find_last_of("/\\");
+        std::string name = slashPos == std::string::npos ? output : output.substr(slashPos + 1);
+        char last = options.outputDir.back();
+        return options.outputDir + ((last == '/' || last == '\\') ? "" : "/") + name;
+    }
+
+    // Creates options.outputDir if it is missing, so that a bad directory
+    // fails once before anything is voxelized rather than at every write.
+    static void MakeOutputDir(const voxOptions &options){
+        if (options.outputDir.empty()) return;
+        std::error_code error;
+        std::filesystem::create_directories(options.outputDir, error);
+        if (error || !std::filesystem::is_directory(options.outputDir, error)) {
+            throw std::runtime_error("Failed to create output directory " + options.outputDir +
+                                     (error ? ": " + error.message() : ""));
+        }
+    }
+
+    // Throws if two different inputs would be written to the same output,
+    // e.g. a/part.stl and b/part.stl with --output-dir.
+    static void CheckOutputs(const std::vector<std::string> &inputs, const voxOptions &options){
+        std::unordered_map<std::string, std::string> writers;
+        for (const std::string &input : inputs) {
+            const std::string source = std::filesystem::absolute(input).lexically_normal().string();
+            const std::string output = std::filesystem::absolute(OutputPath(input, options)).lexically_normal().string();
+            auto it = writers.emplace(output, source).first;
+            if (it->second != source) {
+                throw std::runtime_error("Inputs " + it->second + " and " + source + " would both be written to " + output);
+            }
+        }
+    }
+
+    // One STL path per line; blank lines and lines starting with '#' are skipped.
+    static std::vector<std::string> ReadManifest(const std::string &path){
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open manifest: " + path);
+        }
+        std::vector<std::string> inputs;
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t b = line.find_first_not_of(" \t\r");
+            size_t e = line.find_last_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#') continue;
+            inputs.push_back(line.substr(b, e - b + 1));
+        }
+        return inputs;
+    }
+
+    // Voxelizes mesh slab by slab straight into output; see stl2vox::StreamSlabs.
+    template<typename Mesh>
+    static void StreamFile(Mesh &mesh, const std::string &output, const voxOptions &options){
+        voxGrid grid;
+        stl2vox::PrepareStream(mesh, grid, options);
+        voxSlabWriter writer(output, grid, options.format);
+        stl2vox::StreamSlabs(mesh, grid, options, [&](const voxGrid &slab, int) {
+            voxTimer timer(options.stats, "write");
+            writer.write(slab);
+        });
+        voxTimer timer(options.stats, "write");
+        writer.close();
+    }
+
+    template<typename Mesh>
+    static voxEstimate ReadAndEstimate(const std::string &input, const voxOptions &options){
+        Mesh mesh;
+        stlReader::ReadStlFile(input, mesh, false);
+        if (options.sparse) {
+            sparseGrid grid;
+            return stl2vox::FitGrid(mesh, grid, options, GridKind::Sparse);
+        }
+        voxGrid grid;
+        if (options.stream) return stl2vox::FitGrid(mesh, grid, options, GridKind::Stream);
+        return stl2vox::FitGrid(mesh, grid, options, GridKind::Dense, stl2vox::LevelAlignment(options),
+                                stl2vox::MorphMargin(options));
+    }
+
+    // Component IDs go to part_components next to output, with the table of
+    // components as part_components.csv.
+    template<typename Mesh>
+    static void WriteComponents(const Mesh &mesh, const voxGrid &grid, const std::string &output, const voxOptions &options){
+        voxComponents components;
+        stl2vox::ComponentStage(mesh, grid, options, components);
+        voxTimer timer(options.stats, "write");
+        voxWriter::WriteComponentFile(ReplaceExtension(output, "_components" + std::string(voxWriter::Extension(options.format))),
+                                      components, options.format);
+        components.writeTable(ReplaceExtension(output, "_components.csv"));
+    }
+
+    // Streamed grids are written here; otherwise the result is left in grid
+    // (and distance) or sparse for the write stage.
+    template<typename Mesh>
+    static void Voxelize(Mesh &mesh, const std::string &output, voxGrid &grid, sparseGrid &sparse, voxField &distance,
+                         uint64_t cacheKey, const voxOptions &options){
+        if (options.stream) {
+            StreamFile(mesh, output, options);
+        } else if (options.sparse) {
+            stl2vox::ConvertSparse(mesh, sparse, options);
+        } else {
+            stl2vox::Convert(mesh, grid, options);
+            if (options.sdfBand > 0) stl2vox::DistanceStage(mesh, grid, options, distance);
+            if (UseCache(options)) StoreCached(cacheKey, grid, options);
+            if (options.components) WriteComponents(mesh, grid, output, options);
+            stl2vox::MorphologyStage(grid, options);
+        }
+    }
+
+    template<typename Mesh>
+    static void ReadAndVoxelize(const std::string &input, const std::string &output, voxGrid &grid, sparseGrid &sparse,
+                                voxField &distance, uint64_t cacheKey, const voxOptions &options){
+        Mesh mesh;
+        {
+            voxTimer timer(options.stats, "read");
+            stlReader::ReadStlFile(input, mesh, options.verbose);
+        }
+        Voxelize(mesh, output, grid, sparse, distance, cacheKey, options);
+    }
+
+    static void CheckOptions(const voxOptions &options){
+        if (options.levels > 1 && (options.sparse || options.stream)) {
+            throw std::runtime_error("Pyramid levels need a dense, in-memory grid");
+        }
+        if (options.fill == FillMode::Parity && (options.sparse || options.stream)) {
+            throw std::runtime_error("The parity fill needs a dense, in-memory grid");
+        }
+        if (options.sdfBand > 0 && (options.sparse || options.stream)) {
+            throw std::runtime_error("Signed distances need a dense, in-memory grid");
+        }
+        if (!options.morph.empty() && (options.sparse || options.stream)) {
+            throw std::runtime_error("Morphology needs a dense, in-memory grid");
+        }
+        if (options.components && (options.sparse || options.stream)) {
+            throw std::runtime_error("Connected components need a dense, in-memory grid");
+        }
+        if (options.sdfBand > 0 && !options.morph.empty()) {
+            throw std::runtime_error("Signed distances are measured from the voxelized surface, without --morph");
+        }
+        if (options.components && !options.morph.empty()) {
+            throw std::runtime_error("Components are labelled on the voxelized grid, without --morph");
+        }
+        if (options.components && options.format == voxFormat::Rle) {
+            throw std::runtime_error("Component IDs are written as VTK or VTI");
+        }
+    }
+
+    // Level 0 is written to output itself, level l to part_L<l> next to it.
+    static std::string LevelPath(const std::string &output, int level, voxFormat format){
+        if (level == 0) return output;
+        return ReplaceExtension(output, "_L" + std::to_string(level) + voxWriter::Extension(format));
+    }
+
+    // Writes grid and its options.levels - 1 coarser levels, each reduced from
+    // the one before, so at most two levels are held besides grid. The
+    // distance field, if any, goes with the finest level only.
+    static void WriteLevels(const std::string &output, const voxGrid &grid, const voxOptions &options,
+                            const voxField *distance = nullptr){
+        {
+            voxTimer timer(options.stats, "write");
+            voxWriter::WriteFile(output, grid, options.format, distance);
+        }
+
+        std::unique_ptr<voxGrid> fine, coarse;
+        const voxGrid *current = &grid;
+        for (int level = 1; level < options.levels; ++level) {
+            coarse.reset(new voxGrid());
+            {
+                voxTimer timer(options.stats, "pyramid");
+                voxPyramid::Reduce(*current, *coarse);
+            }
+            voxTimer timer(options.stats, "write");
+            voxWriter::WriteFile(LevelPath(output, level, options.format), *coarse, options.format);
+            fine = std::move(coarse);
+            current = fine.get();
+        }
+    }
+
+    // Writes what Voxelize left in grid, sparse and distance.
+    static void WriteResult(const std::string &output, const voxGrid &grid, const sparseGrid &sparse,
+                            const voxField &distance, const voxOptions &options){
+        if (options.sparse) {
+            voxTimer timer(options.stats, "write");
+            voxWriter::WriteFile(output, sparse, options.format);
+        } else if (!options.stream) {
+            WriteLevels(output, grid, options, options.sdfBand > 0 ? &distance : nullptr);
+        }
+    }
+
+    // Converts a mesh that is already in memory into output, as ConvertFile
+    // does for a file but without the result cache.
+    template<typename Mesh>
+    static void ConvertMesh(Mesh &mesh, const std::string &output, const voxOptions &options){
+        CheckOptions(options);
+        voxOptions meshOptions = options;
+        meshOptions.cacheDir.clear();
+        voxGrid grid;
+        sparseGrid sparse;
+        voxField distance;
+        Voxelize(mesh, output, grid, sparse, distance, 0, meshOptions);
+        WriteResult(output, grid, sparse, distance, meshOptions);
+    }
+
+    // Prints the grid and pre-flight estimate that converting input would
+    // get, without converting it. Returns false when it is over the budget.
+    static bool EstimateFile(const std::string &input, const voxOptions &options){
+        CheckOptions(options);
+        voxOptions estimateOptions = options;
+        estimateOptions.estimateOnly = true;
+        const voxEstimate estimate = options.indexed ? ReadAndEstimate<IndexedMesh>(input, estimateOptions)
+                                                     : ReadAndEstimate<STLMesh>(input, estimateOptions);
+        std::cout << input << ":" << std::endl;
+        estimate.print(std::cout);
+        return !estimate.overBudget();
+    }
+
+    static void ConvertFile(const std::string &input, const voxOptions &options){
+        CheckOptions(options);
+        MakeOutputDir(options);
+        if (options.stats) options.stats->file = input;
+        std::string output = OutputPath(input, options);
+        uint64_t cacheKey = 0;
+        voxGrid grid;
+        if (UseCache(options)) {
+            if (LoadCached(input, options, grid, cacheKey)) {
+                stl2vox::MorphologyStage(grid, options);
+                WriteLevels(output, grid, options);
+                if (options.verbose) std::cout << "Wrote " << output << " from the cache" << std::endl;
+                return;
+            }
+        }
+
+        sparseGrid sparse;
+        voxField distance;
+        if (options.indexed) ReadAndVoxelize<IndexedMesh>(input, output, grid, sparse, distance, cacheKey, options);
+        else ReadAndVoxelize<STLMesh>(input, output, grid, sparse, distance, cacheKey, options);
+        WriteResult(output, grid, sparse, distance, options);
+        if (options.verbose) std::cout << "Wrote " << output << std::endl;
+    }
+
+    // Voxelizes the parts of an assembly list (see voxAssembly::ReadList) into
+    // one material grid, written next to the list as LIST.vtk etc.
+    static void ConvertAssembly(const std::string &listPath, const voxOptions &options){
+        if (options.sparse || options.stream || options.levels > 1 || options.sdfBand > 0 || !options.morph.empty() ||
+            options.components) {
+            throw std::runtime_error("Assemblies are voxelized into one dense material grid, "
+                                     "without --sparse, --stream, --levels, --sdf, --morph or --components");
+        }
+        if (options.format == voxFormat::Rle) throw std::runtime_error("Material grids are written as VTK or VTI");
+        if (options.stats) options.stats->file = listPath;
+        std::vector<voxAssembly::Entry> entries = voxAssembly::ReadList(listPath);
+        voxAssembly::Order(entries, options.overlap);
+
+        voxAssembly assembly;
+        {
+            voxTimer timer(options.stats, "read");
+            for (const voxAssembly::Entry &entry : entries) {
+                STLMesh part;
+                stlReader::ReadStlFile(entry.path, part, options.verbose);
+                assembly.add(part, entry.material, entry.path);
+            }
+        }
+
+        materialGrid grid;
+        if (options.estimateOnly) {
+            const voxEstimate estimate = stl2vox::FitGrid(assembly, grid, options, GridKind::Material);
+            std::cout << listPath << ":" << std::endl;
+            estimate.print(std::cout);
+            return;
+        }
+        MakeOutputDir(options);
+        stl2vox::ConvertAssembly(assembly, grid, options);
+
+        const std::string output = OutputPath(listPath, options);
+        {
+            voxTimer timer(options.stats, "write");
+            voxWriter::WriteMaterialFile(output, grid, options.format);
+        }
+        if (options.verbose) std::cout << "Wrote " << output << std::endl;
+    }
+
+    // Returns the number of files that failed. options.dim, voxelSize or
+    // memoryBudget must be set. When
+    // stats is given it receives one entry per successfully converted file, in
+    // input order; options.stats is ignored.
+    static size_t Run(const std::vector<std::string> &inputs, const voxOptions &options,
+                      std::vector<voxStats> *stats = nullptr){
+        CheckOptions(options);
+        CheckOutputs(inputs, options);
+        MakeOutputDir(options);
+        const int jobs = std::max(1, options.jobs);
+        const int threadsPerJob = std::max(1, HardwareThreads() / jobs);
+        const size_t maxInFlight = (size_t)jobs + 2;
+
+        voxOptions jobOptions = options;
+        jobOptions.verbose = false;
+        jobOptions.stats = nullptr;
+
+        std::vector<std::unique_ptr<voxStats>> collected(stats ? inputs.size() : 0);
+
+        std::mutex mutex;
+        std::condition_variable slotFree;
+        size_t inFlight = 0, voxelizing = 0, done = 0, failed = 0;
+        std::deque<Job*> waiting;
+        threadPool pool(jobs + 2);
+
+        auto finish = [&](Job *job, const std::string &error) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->start).count();
+            std::lock_guard<std::mutex> lock(mutex);
+            ++done;
+            if (error.empty()) {
+                if (stats) collected[job->index].reset(new voxStats(std::move(job->stats)));
+                std::cout << "[" << done << "/" << inputs.size() << "] " << job->input << " -> " << job->output
+                          << " (" << seconds << " s)" << std::endl;
+            } else {
+                ++failed;
+                std::cerr << "[" << done << "/" << inputs.size() << "] " << job->input << " failed: " << error << std::endl;
+            }
+            delete job;
+            --inFlight;
+            slotFree.notify_one();
+        };
+
+        auto write = [&](Job *job) {
+            SetThreads(threadsPerJob);
+            try {
+                if (jobOptions.sparse) {
+                    voxTimer timer(stats ? &job->stats : nullptr, "write");
+                    voxWriter::WriteFile(job->output, job->sparse, jobOptions.format);
+                } else {
+                    voxOptions writeOptions = jobOptions;
+                    writeOptions.stats = stats ? &job->stats : nullptr;
+                    if (job->cached) stl2vox::MorphologyStage(job->grid, writeOptions);
+                    WriteLevels(job->output, job->grid, writeOptions, jobOptions.sdfBand > 0 ? &job->distance : nullptr);
+                }
+            } catch (const std::exception &e) {
+                finish(job, e.what());
+                return;
+            }
+            finish(job, "");
+        };
+
+        std::function<void(Job*)> voxelize = [&](Job *job) {
+            SetThreads(threadsPerJob);
+            std::string error;
+            voxOptions voxelizeOptions = jobOptions;
+            if (stats) voxelizeOptions.stats = &job->stats;
+            try {
+                if (jobOptions.indexed) {
+                    Voxelize(job->indexedMesh, job->output, job->grid, job->sparse, job->distance, job->cacheKey, voxelizeOptions);
+                } else {
+                    Voxelize(job->mesh, job->output, job->grid, job->sparse, job->distance, job->cacheKey, voxelizeOptions);
+                }
+                job->mesh = STLMesh();
+                job->indexedMesh = IndexedMesh();
+            } catch (const std::exception &e) {
+                error = e.what();
+            }
+
+            // Streamed jobs are written while they are voxelized.
+            if (error.empty() && !jobOptions.stream) pool.submit([&, job] { write(job); });
+            else finish(job, error);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (waiting.empty()) {
+                --voxelizing;
+            } else {
+                Job *next = waiting.front();
+                waiting.pop_front();
+                pool.submit([&, next] { voxelize(next); });
+            }
+        };
+
+        auto read = [&](Job *job) {
+            SetThreads(threadsPerJob);
+            try {
+                if (UseCache(jobOptions)) {
+                    voxOptions cacheOptions = jobOptions;
+                    cacheOptions.stats = stats ? &job->stats : nullptr;
+                    job->cached = LoadCached(job->input, cacheOptions, job->grid, job->cacheKey);
+                }
+                if (!job->cached) {
+                    voxTimer timer(stats ? &job->stats : nullptr, "read");
+                    if (jobOptions.indexed) stlReader::ReadStlFile(job->input, job->indexedMesh, false);
+                    else stlReader::ReadStlFile(job->input, job->mesh, false);
+                }
+            } catch (const std::exception &e) {
+                finish(job, e.what());
+                return;
+            }
+
+            // Cache hits go straight to the write stage.
+            if (job->cached) {
+                pool.submit([&, job] { write(job); });
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (voxelizing < (size_t)jobs) {
+                ++voxelizing;
+                pool.submit([&, job] { voxelize(job); });
+            } else {
+                waiting.push_back(job);
+            }
+        };
+
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slotFree.wait(lock, [&] { return inFlight < maxInFlight; });
+                ++inFlight;
+            }
+            Job *job = new Job();
+            job->index = i;
+            job->input = inputs[i];
+            job->output = OutputPath(inputs[i], options);
+            job->stats.file = inputs[i];
+            job->start = std::chrono::steady_clock::now();
+            pool.submit([&, job] { read(job); });
+        }
+
+        pool.wait();
+        if (stats) {
+            for (auto &entry : collected) {
+                if (entry) stats->push_back(std::move(*entry));
+            }
+        }
+        return failed;
+    }
+};
+
+#endif
@@ -0,0 +1,275 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXCACHE_H__
+#define __VOXCACHE_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "voxGrid.h"
+#include "voxHash.h"
+#include "mappedFile.h"
+
+// On-disk cache of finished dense grids, keyed by the hash of the STL payload
+// and the grid size and alignment (origin and spacing follow from those two and are stored
+// in the entry). Each entry is one file with a header and both bit planes, so
+// a hit is loaded by mapping the file instead of voxelizing.
+//
+// Several processes may share one directory: entries are written to a
+// private temporary file and renamed into place, a mapped entry stays valid
+// even if another process evicts it, and eviction (least recently used first,
+// by modification time, which a hit refreshes) runs under an exclusive lock
+// on <dir>/.lock.
+class voxCache
+{
+private:
+    // Bump whenever the grid produced for the same mesh and size changes.
+    static const uint32_t version = 1;
+
+    struct EntryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t wordsPerRow;
+        uint64_t key;
+        int32_t dim[4];
+        double origin[3];
+        double spacing[3];
+        uint64_t numWords;      // words per plane
+        char reserved[32];
+    };
+    static_assert(sizeof(EntryHeader) == 128, "cache entries keep the planes 8-byte aligned");
+
+    std::string dir;
+    uint64_t maxBytes;
+
+    std::string EntryPath(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.vox", (unsigned long long)key);
+        return dir + "/" + name;
+    }
+
+    // Exclusive advisory lock on a file, released on destruction.
+    class dirLock
+    {
+    private:
+        int fd = -1;
+
+    public:
+        explicit dirLock(const std::string &path){
+#if defined(__unix__) || defined(__APPLE__)
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0666);
+            if(fd >= 0) flock(fd, LOCK_EX);
+#else
+            (void)path;
+#endif
+        }
+        ~dirLock(){
+#if defined(__unix__) || defined(__APPLE__)
+            if(fd >= 0){
+                flock(fd, LOCK_UN);
+                ::close(fd);
+            }
+#endif
+        }
+        dirLock(const dirLock&) = delete;
+        dirLock& operator=(const dirLock&) = delete;
+    };
+
+    static std::string UniqueSuffix(){
+        uint64_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+        h = voxHash::Combine(h, (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+#if defined(__unix__) || defined(__APPLE__)
+        h = voxHash::Combine(h, (uint64_t)getpid());
+#endif
+        char text[32];
+        std::snprintf(text, sizeof(text), ".tmp.%016llx", (unsigned long long)h);
+        return text;
+    }
+
+public:
+    voxCache(const std::string &dir, uint64_t maxBytes) : dir(dir), maxBytes(maxBytes) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if(ec){
+            throw std::runtime_error("Failed to create cache directory: " + dir);
+        }
+    }
+
+    // align and margin are the dim alignment and margin passed to
+    // stl2vox::InitBackGrid, fill the voxOptions::fill mode the grid was
+    // classified with and precision the voxOptions::precision it was
+    // rasterized with. indexed is voxOptions::indexed, which rounds ASCII
+    // coordinates to float.
+    static uint64_t Key(uint64_t payloadHash, const int dim[3], int align = 1, int fill = 0, int precision = 0,
+                        int margin = 0, bool indexed = false){
+        uint64_t h = voxHash::Combine(payloadHash, voxHash::Bytes(dim, 3 * sizeof(int)));
+        h = voxHash::Combine(h, (uint64_t)align);
+        h = voxHash::Combine(h, (uint64_t)margin);
+        h = voxHash::Combine(h, (uint64_t)fill);
+        h = voxHash::Combine(h, (uint64_t)precision);
+        h = voxHash::Combine(h, (uint64_t)indexed);
+        return voxHash::Combine(h, version);
+    }
+
+    // Maps the entry for key into grid. Returns false on a miss, including
+    // entries that are damaged or were evicted while being opened.
+    bool load(uint64_t key, voxGrid &grid){
+        const std::string path = EntryPath(key);
+        auto file = std::make_shared<mappedFile>();
+        try {
+            file->Open(path, true);
+        } catch (const std::exception&) {
+            return false;
+        }
+
+        EntryHeader header;
+        if(file->size() < sizeof(header)) return false;
+        std::memcpy(&header, file->data(), sizeof(header));
+        const uint64_t planeWords = (uint64_t)header.wordsPerRow * header.dim[1] * header.dim[2];
+        if(std::memcmp(header.magic, "STL2VOX", 8) != 0 || header.version != version || header.key != key ||
+           header.dim[0] <= 0 || header.dim[1] <= 0 || header.dim[2] <= 0 ||
+           header.wordsPerRow != (uint32_t)((header.dim[0] + 63) / 64) || header.numWords != planeWords ||
+           file->size() != sizeof(header) + 2 * planeWords * sizeof(uint64_t)){
+            return false;
+        }
+
+        for(int k = 0; k < 3; ++k){
+            grid.dim[k] = header.dim[k];
+            grid.origin[k] = header.origin[k];
+            grid.spacing[k] = header.spacing[k];
+        }
+        grid.wordsPerRow = (int)header.wordsPerRow;
+        uint64_t *words = reinterpret_cast<uint64_t*>(file->data() + sizeof(header));
+        grid.surface.view(words, planeWords, file);
+        grid.outside.view(words + planeWords, planeWords, file);
+
+        std::error_code ec;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+        return true;
+    }
+
+    // Adds grid as the entry for key and evicts old entries if the cache is
+    // over its size limit. Returns false if the entry could not be written.
+    bool store(uint64_t key, const voxGrid &grid){
+        EntryHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "STL2VOX", 8);
+        header.version = version;
+        header.wordsPerRow = (uint32_t)grid.wordsPerRow;
+        header.key = key;
+        for(int k = 0; k < 3; ++k){
+            header.dim[k] = grid.dim[k];
+            header.origin[k] = grid.origin[k];
+            header.spacing[k] = grid.spacing[k];
+        }
+        header.numWords = grid.surface.size();
+
+        const std::string path = EntryPath(key);
+        const std::string temp = path + UniqueSuffix();
+        {
+            std::ofstream file(temp, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(grid.surface.data()), grid.surface.size() * sizeof(uint64_t));
+            file.write(reinterpret_cast<const char*>(grid.outside.data()), grid.outside.size() * sizeof(uint64_t));
+            file.close();
+            if(!file){
+                std::error_code ec;
+                std::filesystem::remove(temp, ec);
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+        if(ec){
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+        evict();
+        return true;
+    }
+
+    // Removes the least recently used entries until the cache fits its limit,
+    // and temporary files abandoned for more than an hour.
+    void evict(){
+        dirLock lock(dir + "/.lock");
+
+        struct Entry {
+            std::filesystem::file_time_type time;
+            uint64_t size;
+            std::filesystem::path path;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        const auto now = std::filesystem::file_time_type::clock::now();
+
+        std::error_code ec;
+        for(const auto &item : std::filesystem::directory_iterator(dir, ec)){
+            std::error_code itemError;
+            const std::string name = item.path().filename().string();
+            const auto time = item.last_write_time(itemError);
+            if(itemError) continue;
+            if(name.find(".vox.tmp.") != std::string::npos){
+                if(now - time > std::chrono::hours(1)) std::filesystem::remove(item.path(), itemError);
+                continue;
+            }
+            if(name.size() < 4 || name.compare(name.size() - 4, 4, ".vox") != 0) continue;
+            const uint64_t size = item.file_size(itemError);
+            if(itemError) continue;
+            entries.push_back({time, size, item.path()});
+            total += size;
+        }
+        if(total <= maxBytes) return;
+
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.time < b.time; });
+        for(const Entry &entry : entries){
+            if(total <= maxBytes) break;
+            std::error_code removeError;
+            if(std::filesystem::remove(entry.path, removeError)) total -= entry.size;
+        }
+    }
+};
+
+#endif
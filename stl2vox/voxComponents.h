@@ -0,0 +1,241 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXCOMPONENTS_H__
+#define __VOXCOMPONENTS_H__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "voxGrid.h"
+#include "runLabels.h"
+#include "voxParity.h"
+
+// Connected components of a converted grid: the solid bodies, and the
+// cavities, sealed voids that the flood fill cannot reach and so labels
+// inside. Both are 6-connected and found by union-find over X runs (see
+// runLabeling), never per voxel. The free (non-surface) voxels are labelled
+// first; a free component touching the grid boundary is the exterior, and an
+// enclosed one is material when at least two of the X, Y and Z rays through
+// its first voxel cross the mesh an odd number of times before it (the vote
+// of voxParity::Classify), a cavity otherwise. The bodies are
+// then the components of the surface voxels together with the material ones.
+// Only the surface plane and the mesh are used, so flood and parity filled
+// grids give the same components.
+//
+// IDs number the bodies 1, 2, ... and then the cavities, each in the order of
+// its first voxel (Z, then Y, then X); the exterior is 0.
+struct voxComponents
+{
+    enum class Kind { Body, Cavity };
+
+    struct Component {
+        Kind kind;
+        uint64_t voxels = 0;
+        int lo[3];      // inclusive voxel bounding box
+        int hi[3];
+    };
+
+    double origin[3] = {0, 0, 0};
+    double spacing[3] = {1, 1, 1};
+    int dim[3] = {0, 0, 0};
+    std::vector<Component> table;   // component ID i + 1
+    size_t numBodies = 0;
+    size_t numCavities = 0;
+
+    size_t numVoxels() const { return (size_t)dim[0] * dim[1] * dim[2]; }
+
+    template<typename Mesh>
+    void label(const Mesh &mesh, const voxGrid &grid){
+        for (int i = 0; i < 3; ++i) {
+            origin[i] = grid.origin[i];
+            spacing[i] = grid.spacing[i];
+            dim[i] = grid.dim[i];
+        }
+        const int numX = dim[0], numY = dim[1], numZ = dim[2];
+        const int wordsPerRow = grid.wordsPerRow;
+        const uint64_t tail = bitRow::TailMask(numX);
+
+        // Free voxels, then the components among them.
+        std::vector<uint64_t> plane(grid.surface.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long r = 0; r < (long long)numY * numZ; ++r) {
+            const size_t row = (size_t)r * wordsPerRow;
+            for (int w = 0; w < wordsPerRow; ++w) plane[row + w] = ~grid.surface[row + w];
+            plane[row + wordsPerRow - 1] &= tail;
+        }
+        runLabeling::Build(free, numX, numY, numZ, [&](int y, int z) { return plane.data() + grid.rowOffset(y, z); });
+        runLabeling::Label(free);
+
+        // Exterior components, and the first voxel of each enclosed one for the parity test.
+        std::vector<uint8_t> exterior(free.numRuns(), 0);
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                const bool edgeRow = z == 0 || z == numZ - 1 || y == 0 || y == numY - 1;
+                for (size_t i = free.rowBegin(y, z); i < free.rowEnd(y, z); ++i) {
+                    if (edgeRow || free.x0[i] == 0 || free.x1[i] == numX - 1) exterior[free.parent[i]] = 1;
+                }
+            }
+        }
+        std::vector<std::array<int, 3>> firstVoxels;
+        std::vector<uint32_t> enclosed;
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                for (size_t i = free.rowBegin(y, z); i < free.rowEnd(y, z); ++i) {
+                    if (free.parent[i] != i || exterior[i]) continue;
+                    firstVoxels.push_back({free.x0[i], y, z});
+                    enclosed.push_back((uint32_t)i);
+                }
+            }
+        }
+        std::vector<uint8_t> material(firstVoxels.size(), 0);
+        for (int a = 0; a < 3; ++a) {
+            const std::vector<uint8_t> vote = voxParity::InsideAlong(mesh, grid, a, firstVoxels);
+            for (size_t c = 0; c < material.size(); ++c) material[c] += vote[c];
+        }
+
+        // Free runs keep a provisional cavity number (1, 2, ...), material and
+        // exterior runs 0.
+        std::vector<uint8_t> solidRoot(free.numRuns(), 0);
+        freeId.assign(free.numRuns(), 0);
+        for (size_t c = 0; c < enclosed.size(); ++c) {
+            if (material[c] >= 2) solidRoot[enclosed[c]] = 1;
+            else freeId[enclosed[c]] = (uint32_t)++numCavities;
+        }
+        exterior = std::vector<uint8_t>();
+
+        // Solid voxels: the surface and the material runs, then the bodies.
+        std::memcpy(plane.data(), grid.surface.data(), plane.size() * sizeof(uint64_t));
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                for (size_t i = free.rowBegin(y, z); i < free.rowEnd(y, z); ++i) {
+                    freeId[i] = freeId[free.parent[i]];
+                    if (solidRoot[free.parent[i]]) bitRow::SetRange(plane.data() + grid.rowOffset(y, z), free.x0[i], free.x1[i] + 1);
+                }
+            }
+        }
+        solidRoot = std::vector<uint8_t>();
+        runLabeling::Build(solid, numX, numY, numZ, [&](int y, int z) { return plane.data() + grid.rowOffset(y, z); });
+        plane = std::vector<uint64_t>();
+        runLabeling::Label(solid);
+
+        solidId.assign(solid.numRuns(), 0);
+        for (size_t i = 0; i < solid.numRuns(); ++i) {
+            solidId[i] = solid.parent[i] == i ? (uint32_t)++numBodies : solidId[solid.parent[i]];
+        }
+        if (numBodies + numCavities > UINT32_MAX) throw std::runtime_error("Too many components for 32-bit IDs");
+
+        // Sizes and bounding boxes.
+        table.assign(numBodies + numCavities, Component());
+        for (size_t c = 0; c < table.size(); ++c) {
+            table[c].kind = c < numBodies ? Kind::Body : Kind::Cavity;
+            for (int i = 0; i < 3; ++i) {
+                table[c].lo[i] = dim[i];
+                table[c].hi[i] = -1;
+            }
+        }
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                for (size_t i = solid.rowBegin(y, z); i < solid.rowEnd(y, z); ++i) {
+                    Add(table[solidId[i] - 1], solid.x0[i], solid.x1[i], y, z);
+                }
+                for (size_t i = free.rowBegin(y, z); i < free.rowEnd(y, z); ++i) {
+                    if (freeId[i]) Add(table[numBodies + freeId[i] - 1], free.x0[i], free.x1[i], y, z);
+                }
+            }
+        }
+    }
+
+    // Writes the component IDs of layers [z0, z1), X fastest.
+    void extract(int z0, int z1, uint32_t *out) const {
+        const int numX = dim[0], numY = dim[1];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long r = (long long)z0 * numY; r < (long long)z1 * numY; ++r) {
+            const int y = (int)(r % numY), z = (int)(r / numY);
+            uint32_t *dst = out + (size_t)(r - (long long)z0 * numY) * numX;
+            std::fill(dst, dst + numX, 0);
+            for (size_t i = solid.rowBegin(y, z); i < solid.rowEnd(y, z); ++i) {
+                std::fill(dst + solid.x0[i], dst + solid.x1[i] + 1, solidId[i]);
+            }
+            for (size_t i = free.rowBegin(y, z); i < free.rowEnd(y, z); ++i) {
+                if (freeId[i]) std::fill(dst + free.x0[i], dst + free.x1[i] + 1, (uint32_t)(numBodies + freeId[i]));
+            }
+        }
+    }
+
+    // One CSV line per component: ID, kind, voxel count, volume and the
+    // inclusive voxel bounding box.
+    void writeTable(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        const double voxelVolume = spacing[0] * spacing[1] * spacing[2];
+        file << "id,kind,voxels,volume,x0,y0,z0,x1,y1,z1\n";
+        for (size_t c = 0; c < table.size(); ++c) {
+            const Component &component = table[c];
+            file << c + 1 << ',' << (component.kind == Kind::Body ? "body" : "cavity") << ',' << component.voxels
+                 << ',' << component.voxels * voxelVolume;
+            for (int i = 0; i < 3; ++i) file << ',' << component.lo[i];
+            for (int i = 0; i < 3; ++i) file << ',' << component.hi[i];
+            file << '\n';
+        }
+        if (!file) throw std::runtime_error("Failed to write file: " + path);
+    }
+
+private:
+    runTable free;                  // runs of the free voxels
+    runTable solid;                 // runs of the solid voxels
+    std::vector<uint32_t> freeId;   // cavity number of each free run, 0 for exterior and material
+    std::vector<uint32_t> solidId;  // body ID of each solid run
+
+    static void Add(Component &component, int x0, int x1, int y, int z){
+        component.voxels += x1 - x0 + 1;
+        component.lo[0] = std::min(component.lo[0], x0);
+        component.hi[0] = std::max(component.hi[0], x1);
+        component.lo[1] = std::min(component.lo[1], y);
+        component.hi[1] = std::max(component.hi[1], y);
+        component.lo[2] = std::min(component.lo[2], z);
+        component.hi[2] = std::max(component.hi[2], z);
+    }
+};
+
+#endif
@@ -0,0 +1,341 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXDISTANCE_H__
+#define __VOXDISTANCE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stlMesh.h"
+#include "voxGrid.h"
+
+// Signed distance from every voxel center to the mesh, negative inside.
+// Voxels within `band` voxels of a triangle's box get the exact distance to
+// the nearest triangle; the rest of the grid is filled by fast sweeping
+// (first-order Godunov upwind solution of |grad d| = 1) outward from the
+// exact values. The sign comes from the classified grid, and for surface
+// voxels from the side of the nearest triangle their center lies on.
+class voxDistance
+{
+public:
+    struct Counters {
+        size_t tests = 0;   // voxel/triangle distance evaluations
+        size_t rounds = 0;  // rounds of eight sweeps until no value changed
+    };
+
+private:
+    // Per-voxel flags.
+    static const uint8_t Exact = 1;     // distance is exact and not swept
+    static const uint8_t Negative = 2;  // surface voxel inside its nearest triangle
+
+    static const int maxRounds = 8;
+
+    static void Sub(const double a[3], const double b[3], double out[3]){
+        out[0] = a[0] - b[0]; out[1] = a[1] - b[1]; out[2] = a[2] - b[2];
+    }
+
+    static double Dot(const double a[3], const double b[3]){
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Closest point q to p on triangle abc, by the Voronoi regions of its
+    // vertices and edges (Ericson, Real-Time Collision Detection, 5.1.5).
+    static void ClosestPoint(const double p[3], const double a[3], const double b[3], const double c[3], double q[3]){
+        double ab[3], ac[3], ap[3], bp[3], cp[3];
+        Sub(b, a, ab); Sub(c, a, ac); Sub(p, a, ap);
+        const double d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+        if (d1 <= 0 && d2 <= 0) { std::copy(a, a + 3, q); return; }
+
+        Sub(p, b, bp);
+        const double d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+        if (d3 >= 0 && d4 <= d3) { std::copy(b, b + 3, q); return; }
+
+        const double vc = d1 * d4 - d3 * d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+            const double v = d1 / (d1 - d3);
+            for (int k = 0; k < 3; ++k) q[k] = a[k] + v * ab[k];
+            return;
+        }
+
+        Sub(p, c, cp);
+        const double d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+        if (d6 >= 0 && d5 <= d6) { std::copy(c, c + 3, q); return; }
+
+        const double vb = d5 * d2 - d1 * d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+            const double w = d2 / (d2 - d6);
+            for (int k = 0; k < 3; ++k) q[k] = a[k] + w * ac[k];
+            return;
+        }
+
+        const double va = d3 * d6 - d5 * d4;
+        if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+            const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            for (int k = 0; k < 3; ++k) q[k] = b[k] + w * (c[k] - b[k]);
+            return;
+        }
+
+        const double denom = 1 / (va + vb + vc);
+        const double v = vb * denom, w = vc * denom;
+        for (int k = 0; k < 3; ++k) q[k] = a[k] + ab[k] * v + ac[k] * w;
+    }
+
+    // First and last voxel whose center lies in [lo, hi] along axis.
+    static int FirstCenter(const voxGrid &grid, int axis, double lo){
+        return std::max(0, (int)std::ceil((lo - grid.origin[axis]) / grid.spacing[axis] - 0.5));
+    }
+
+    static int LastCenter(const voxGrid &grid, int axis, double hi){
+        return std::min(grid.dim[axis] - 1, (int)std::floor((hi - grid.origin[axis]) / grid.spacing[axis] - 0.5));
+    }
+
+    // Exact distances within the band, one Z layer per task. Every layer owns
+    // its values, so triangles are binned by the layers their widened box covers.
+    template<typename Mesh>
+    static void ComputeBand(const Mesh &mesh, const voxGrid &grid, int band, float *dist, uint8_t *flags,
+                            Counters &counters){
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        const long long triCount = (long long)mesh.size();
+        double pad[3];
+        for (int k = 0; k < 3; ++k) pad[k] = band * grid.spacing[k];
+
+        std::vector<int> first(triCount), last(triCount);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long t = 0; t < triCount; ++t) {
+            double lo[3], hi[3];
+            mesh.bounds(t, lo, hi);
+            first[t] = FirstCenter(grid, 2, lo[2] - pad[2]);
+            last[t] = LastCenter(grid, 2, hi[2] + pad[2]);
+        }
+        std::vector<size_t> offsets(numZ + 1, 0);
+        for (long long t = 0; t < triCount; ++t) {
+            for (int z = first[t]; z <= last[t]; ++z) ++offsets[z + 1];
+        }
+        for (int z = 0; z < numZ; ++z) offsets[z + 1] += offsets[z];
+        std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+        std::vector<uint32_t> indices(offsets.back());
+        for (long long t = 0; t < triCount; ++t) {
+            for (int z = first[t]; z <= last[t]; ++z) indices[cursor[z]++] = (uint32_t)t;
+        }
+
+        const double exact = band * std::min(grid.spacing[0], std::min(grid.spacing[1], grid.spacing[2]));
+        const size_t layerVoxels = (size_t)numX * numY;
+        size_t tests = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:tests)
+#endif
+        for (int z = 0; z < numZ; ++z) {
+            float *layer = dist + z * layerVoxels;
+            uint8_t *layerFlags = flags + z * layerVoxels;
+            std::vector<double> best(layerVoxels, std::numeric_limits<double>::infinity());
+            double p[3];
+            p[2] = grid.origin[2] + (z + 0.5) * grid.spacing[2];
+            for (size_t i = offsets[z]; i < offsets[z + 1]; ++i) {
+                const size_t t = indices[i];
+                const Triangle &triangle = mesh.triangle(t);
+                const double a[3] = { triangle.v0.x, triangle.v0.y, triangle.v0.z };
+                const double b[3] = { triangle.v1.x, triangle.v1.y, triangle.v1.z };
+                const double c[3] = { triangle.v2.x, triangle.v2.y, triangle.v2.z };
+                double ab[3], ac[3], normal[3];
+                Sub(b, a, ab);
+                Sub(c, a, ac);
+                normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+                normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+                normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+                if (Dot(normal, normal) == 0) continue; // degenerate, covered by its neighbours
+
+                double lo[3], hi[3];
+                mesh.bounds(t, lo, hi);
+                const int x0 = FirstCenter(grid, 0, lo[0] - pad[0]), x1 = LastCenter(grid, 0, hi[0] + pad[0]);
+                const int y0 = FirstCenter(grid, 1, lo[1] - pad[1]), y1 = LastCenter(grid, 1, hi[1] + pad[1]);
+                for (int y = y0; y <= y1; ++y) {
+                    p[1] = grid.origin[1] + (y + 0.5) * grid.spacing[1];
+                    for (int x = x0; x <= x1; ++x) {
+                        p[0] = grid.origin[0] + (x + 0.5) * grid.spacing[0];
+                        double q[3], d[3];
+                        ClosestPoint(p, a, b, c, q);
+                        Sub(p, q, d);
+                        const double distSq = Dot(d, d);
+                        const size_t v = (size_t)y * numX + x;
+                        if (distSq >= best[v]) continue;
+                        best[v] = distSq;
+                        if (grid.isSurface(x, y, z)) {
+                            if (Dot(d, normal) < 0) layerFlags[v] |= Negative;
+                            else layerFlags[v] &= ~Negative;
+                        }
+                    }
+                    tests += x1 >= x0 ? x1 - x0 + 1 : 0;
+                }
+            }
+            for (size_t v = 0; v < layerVoxels; ++v) {
+                const double d = std::sqrt(best[v]);
+                layer[v] = (float)d;
+                if (d <= exact) layerFlags[v] |= Exact;
+            }
+        }
+        counters.tests += tests;
+    }
+
+    // Grid constants of the sweeps.
+    struct Stencil {
+        int dim[3];
+        size_t stride[3];
+        double weight[3];   // 1 / spacing^2
+    };
+
+    // Puts the pair with the smaller n first, without branches.
+    static void Order(double &na, double &wa, double &nb, double &wb){
+        const bool swap = nb < na;
+        const double n0 = swap ? nb : na, n1 = swap ? na : nb;
+        const double w0 = swap ? wb : wa, w1 = swap ? wa : wb;
+        na = n0; nb = n1; wa = w0; wb = w1;
+    }
+
+    // Godunov update of voxel v from its smaller neighbour n_k along each
+    // axis: the largest root d of sum(w_k (d - n_k)^2) = 1 over the axes whose
+    // neighbour lies below d. Written without data-dependent branches but
+    // one, since the sweeps spend most of their time here.
+    static float Update(const float *dist, const Stencil &stencil, const int at[3], size_t v){
+        const float current = dist[v];
+        const float inf = std::numeric_limits<float>::infinity();
+        double n[3], w[3];
+        for (int k = 0; k < 3; ++k) {
+            const float lower = at[k] > 0 ? dist[v - stencil.stride[k]] : inf;
+            const float upper = at[k] < stencil.dim[k] - 1 ? dist[v + stencil.stride[k]] : inf;
+            n[k] = std::min(lower, upper);
+            w[k] = stencil.weight[k];
+        }
+        Order(n[0], w[0], n[1], w[1]);
+        Order(n[1], w[1], n[2], w[2]);
+        Order(n[0], w[0], n[1], w[1]);
+        if (!(n[0] < current)) return current;
+
+        // Axis i takes part when the root over the axes before it lies above
+        // n[i], that is when sum_{j<i} w_j (n_i - n_j)^2 < 1.
+        const double f1 = w[0] * (n[1] - n[0]) * (n[1] - n[0]);
+        const double f2 = w[0] * (n[2] - n[0]) * (n[2] - n[0]) + w[1] * (n[2] - n[1]) * (n[2] - n[1]);
+        const bool use1 = f1 < 1;
+        const bool use2 = use1 && f2 < 1;
+        const double sw = w[0] + (use1 ? w[1] : 0) + (use2 ? w[2] : 0);
+        const double swn = w[0] * n[0] + (use1 ? w[1] * n[1] : 0) + (use2 ? w[2] * n[2] : 0);
+        const double swnn = w[0] * n[0] * n[0] + (use1 ? w[1] * n[1] * n[1] : 0) + (use2 ? w[2] * n[2] * n[2] : 0);
+        const double d = (swn + std::sqrt(std::max(0.0, swn * swn - sw * (swnn - 1)))) / sw;
+        return std::min(current, (float)d);
+    }
+
+    // One Gauss-Seidel sweep in the direction (sx, sy, sz). A row depends on
+    // the rows before it in Y and Z, so the rows on one anti-diagonal
+    // y' + z' = level (in sweep order) are updated in parallel, each along X.
+    static bool Sweep(float *dist, const uint8_t *flags, const voxGrid &grid, int sx, int sy, int sz){
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        Stencil stencil;
+        for (int k = 0; k < 3; ++k) {
+            stencil.dim[k] = grid.dim[k];
+            stencil.weight[k] = 1 / (grid.spacing[k] * grid.spacing[k]);
+        }
+        stencil.stride[0] = 1;
+        stencil.stride[1] = (size_t)numX;
+        stencil.stride[2] = (size_t)numX * numY;
+        const float tolerance = 1e-4f * (float)std::min(grid.spacing[0], std::min(grid.spacing[1], grid.spacing[2]));
+
+        bool changed = false;
+        for (int level = 0; level <= numY + numZ - 2; ++level) {
+            const int k0 = std::max(0, level - (numY - 1));
+            const int k1 = std::min(numZ - 1, level);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(||:changed)
+#endif
+            for (int k = k0; k <= k1; ++k) {
+                int at[3];
+                at[2] = sz > 0 ? k : numZ - 1 - k;
+                at[1] = sy > 0 ? level - k : numY - 1 - (level - k);
+                const size_t row = ((size_t)at[2] * numY + at[1]) * numX;
+                for (int i = 0; i < numX; ++i) {
+                    at[0] = sx > 0 ? i : numX - 1 - i;
+                    const size_t v = row + at[0];
+                    if (flags[v] & Exact) continue;
+                    const float d = Update(dist, stencil, at, v);
+                    if (d < dist[v] - tolerance) changed = true;
+                    dist[v] = d;
+                }
+            }
+        }
+        return changed;
+    }
+
+public:
+    // Fills field with the signed distance of every voxel of grid, whose
+    // outside plane must already be classified. band is in voxels (>= 1).
+    template<typename Mesh>
+    static Counters Compute(const Mesh &mesh, const voxGrid &grid, int band, voxField &field){
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        const size_t numVoxels = grid.numVoxels();
+        Counters counters;
+        field.name = "distance";
+        field.values.assign(numVoxels, std::numeric_limits<float>::infinity());
+        std::vector<uint8_t> flags(numVoxels, 0);
+        float *dist = field.values.data();
+
+        ComputeBand(mesh, grid, std::max(1, band), dist, flags.data(), counters);
+
+        bool changed = true;
+        while (changed && counters.rounds < (size_t)maxRounds) {
+            changed = false;
+            for (int s = 0; s < 8; ++s) {
+                changed |= Sweep(dist, flags.data(), grid, s & 1 ? -1 : 1, s & 2 ? -1 : 1, s & 4 ? -1 : 1);
+            }
+            ++counters.rounds;
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                float *row = dist + ((size_t)z * numY + y) * numX;
+                const uint8_t *rowFlags = flags.data() + ((size_t)z * numY + y) * numX;
+                for (int x = 0; x < numX; ++x) {
+                    const int label = grid.get(x, y, z);
+                    if (label > 0 || (label == 0 && (rowFlags[x] & Negative))) row[x] = -row[x];
+                }
+            }
+        }
+        return counters;
+    }
+};
+
+#endif
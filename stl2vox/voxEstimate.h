@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXESTIMATE_H__
+#define __VOXESTIMATE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stlMesh.h"
+#include "voxOptions.h"
+
+// What is being fitted: a dense voxGrid, the slabs of a streamed one, a
+// sparseGrid or the materialGrid of an assembly.
+enum class GridKind { Dense, Stream, Sparse, Material };
+
+// The mesh as the pre-flight estimate sees it, gathered in one pass so that
+// many candidate grids can be estimated without touching the mesh again.
+struct meshSummary
+{
+    double lo[3] = {0, 0, 0};
+    double hi[3] = {0, 0, 0};
+    double projected[3] = {0, 0, 0};  // total triangle area projected along X, Y and Z
+    size_t triangles = 0;
+    size_t bytes = 0;                 // memory held by the mesh
+
+    template<typename Mesh>
+    static meshSummary Of(const Mesh &mesh){
+        meshSummary summary;
+        summary.triangles = mesh.size();
+        summary.bytes = mesh.memoryBytes();
+        if (summary.triangles == 0) throw std::runtime_error("The mesh has no triangles");
+        mesh.bounds(0, summary.lo, summary.hi);
+
+        const long long triCount = (long long)mesh.size();
+        double ax = 0, ay = 0, az = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+:ax, ay, az)
+#endif
+        for (long long t = 0; t < triCount; ++t) {
+            const Triangle tri = mesh.triangle(t);
+            const Vector3d normal = (tri.v1 - tri.v0).cross(tri.v2 - tri.v0);
+            ax += std::abs(normal.x);
+            ay += std::abs(normal.y);
+            az += std::abs(normal.z);
+        }
+        for (size_t t = 1; t < summary.triangles; ++t) {
+            double lo[3], hi[3];
+            mesh.bounds(t, lo, hi);
+            for (int k = 0; k < 3; ++k) {
+                summary.lo[k] = std::min(summary.lo[k], lo[k]);
+                summary.hi[k] = std::max(summary.hi[k], hi[k]);
+            }
+        }
+        summary.projected[0] = ax / 2;
+        summary.projected[1] = ay / 2;
+        summary.projected[2] = az / 2;
+        return summary;
+    }
+
+    // Voxels the surface passes through: a sheet crosses about one voxel per
+    // voxel face of its projection along each axis.
+    double surfaceVoxels(const double spacing[3]) const {
+        return projected[0] / (spacing[1] * spacing[2]) + projected[1] / (spacing[0] * spacing[2]) +
+               projected[2] / (spacing[0] * spacing[1]);
+    }
+};
+
+// Pre-flight estimate of a conversion from the fitted grid size and the mesh
+// summary, before anything is allocated (see stl2vox::FitGrid). The grid is
+// held through every stage; the temporary memory is that of the hungriest
+// stage on top of it. Times come from per-voxel and per-surface-voxel costs
+// measured on one core, spread over the threads, and are a rough guide only.
+struct voxEstimate
+{
+    int dim[3] = {0, 0, 0};
+    double spacing[3] = {0, 0, 0};
+    uint64_t gridBytes = 0;     // the result, held until it is written
+    uint64_t tempBytes = 0;     // working memory of the largest stage
+    uint64_t meshBytes = 0;
+    double seconds = 0;
+    uint64_t budget = 0;        // voxOptions::memoryBudget, 0 for none
+    bool downgraded = false;    // coarsened to fit the budget
+
+    uint64_t totalBytes() const { return gridBytes + tempBytes + meshBytes; }
+
+    bool overBudget() const { return budget > 0 && totalBytes() > budget; }
+
+    static voxEstimate Of(const meshSummary &mesh, const int dim[3], const double spacing[3], GridKind kind,
+                          const voxOptions &options, int threads){
+        voxEstimate estimate;
+        for (int k = 0; k < 3; ++k) {
+            estimate.dim[k] = dim[k];
+            estimate.spacing[k] = spacing[k];
+        }
+        estimate.budget = options.memoryBudget;
+        estimate.meshBytes = mesh.bytes;
+
+        const double voxels = (double)dim[0] * dim[1] * dim[2];
+        const double rows = (double)dim[1] * dim[2];
+        const double plane = rows * ((dim[0] + 63) / 64) * sizeof(uint64_t);
+        const double surface = std::min(voxels, mesh.surfaceVoxels(spacing));
+        const double bins = 8.0 * mesh.triangles;   // slab bins, about two slabs per triangle
+        const double block = double(4 << 20);       // voxWriter::blockBytes
+        const double write = WriteCost(options.format);
+        double grid = 0, temp = bins, cost = 0, written = voxels;
+
+        switch (kind) {
+            case GridKind::Dense:
+                grid = 2 * plane;
+                cost = voxels * fillCost + surface * surfaceCost;
+                if (options.fill == FillMode::Parity) {
+                    temp = std::max(temp, plane + bins);
+                    cost += surface * surfaceCost;
+                }
+                if (options.sdfBand > 0) {
+                    const double band = 2 * options.sdfBand + 1;
+                    grid += voxels * sizeof(float);
+                    temp = std::max(temp, voxels + bins);
+                    cost += surface * band * band * band * distanceCost;
+                    written += voxels * sizeof(float);
+                }
+                for (const morphStep &step : options.morph) {
+                    temp = std::max(temp, 3 * plane);
+                    cost += voxels * morphCost * step.radius * (step.op == MorphOp::Open || step.op == MorphOp::Close ? 2 : 1);
+                }
+                if (options.components) {
+                    temp = std::max(temp, plane + 20 * surface + 16 * rows);
+                    cost += voxels * fillCost;
+                    written += voxels * sizeof(uint32_t);
+                }
+                if (options.levels > 1) {
+                    temp = std::max(temp, plane / 3);
+                    written += voxels / 7;
+                }
+                break;
+            case GridKind::Stream: {
+                const double layer = 2 * plane / std::max(1, dim[2]);
+                const double depth = options.streamDepth > 0 ? std::min(options.streamDepth, dim[2])
+                                                             : std::min<double>(dim[2], std::max(1.0, double(256 << 20) / layer));
+                grid = layer * depth;
+                temp = grid / 4 + bins;     // interface rows and the runs of a slab
+                cost = voxels * fillCost + 2.5 * surface * surfaceCost;
+                break;
+            }
+            case GridKind::Sparse: {
+                // A sheet crosses about one 8x8x8 brick per 64 of its voxels.
+                const double bricks = std::min(voxels / 512, 1.5 * surface / 64);
+                grid = bricks * (128 + 48) + voxels / 4096;
+                temp = bins + bricks * 16;
+                cost = 4 * surface * surfaceCost + 3 * voxels * write;
+                break;
+            }
+            case GridKind::Material:
+                grid = voxels * sizeof(uint16_t);
+                temp = bins + threads * 16 * plane / std::max(1, dim[2]);
+                cost = voxels * fillCost + 2 * surface * surfaceCost;
+                written = voxels * sizeof(uint16_t);
+                break;
+        }
+        if (options.format == voxFormat::VTIZlib) temp = std::max(temp, written / 16 + threads * 2 * block);
+        else temp = std::max(temp, block * (options.sdfBand > 0 ? 5 : 1));
+        cost += written * write;
+
+        estimate.gridBytes = (uint64_t)grid;
+        estimate.tempBytes = (uint64_t)temp;
+        estimate.seconds = cost / (1 + 0.75 * (std::max(1, threads) - 1));
+        return estimate;
+    }
+
+    void print(std::ostream &out) const {
+        const double mib = 1024.0 * 1024.0;
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+        out << "Grid " << dim[0] << " x " << dim[1] << " x " << dim[2] << ", voxel " << spacing[0] << " x "
+            << spacing[1] << " x " << spacing[2] << (downgraded ? " (coarsened to fit the memory budget)" : "") << std::endl;
+        out << std::fixed << std::setprecision(1) << "Estimate: grid " << gridBytes / mib << " MiB, temporary "
+            << tempBytes / mib << " MiB, mesh " << meshBytes / mib << " MiB, total " << totalBytes() / mib
+            << " MiB, about " << seconds << " s";
+        if (overBudget()) out << ", over the budget of " << budget / mib << " MiB";
+        out << std::endl;
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    // Seconds per voxel to allocate and fill the grid, per surface voxel to
+    // rasterize it, per surface voxel and band voxel of a distance field, per
+    // voxel and radius of a morphology pass, and per byte written.
+    static constexpr double fillCost = 1e-9;
+    static constexpr double surfaceCost = 170e-9;
+    static constexpr double distanceCost = 170e-9;
+    static constexpr double morphCost = 0.5e-9;
+
+    static double WriteCost(voxFormat format){
+        switch (format) {
+            case voxFormat::VTKAscii: return 70e-9;
+            case voxFormat::VTIZlib: return 4e-9;
+            case voxFormat::Rle: return 1e-9;
+            default: return 3e-9;
+        }
+    }
+};
+
+#endif
@@ -28,19 +28,152 @@
 #ifndef __VOXGRID_H__
 #define __VOXGRID_H__
 
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Array of 64-bit words that is zeroed in parallel on allocation, so under a
+// first-touch NUMA policy each page lands on the node of the thread that
+// processes the same Z range later.
+class wordBuffer
+{
+private:
+    uint64_t *ptr = nullptr;
+    size_t count = 0;
+    std::unique_ptr<uint64_t[]> owned;
+    std::shared_ptr<void> owner;    // keeps external storage alive, see view()
+
+public:
+    void allocate(size_t numWords, size_t wordsPerLayer){
+        clear();
+        owned.reset(new uint64_t[numWords]);
+        ptr = owned.get();
+        count = numWords;
+        const long long layers = wordsPerLayer ? (long long)(numWords / wordsPerLayer) : 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(long long z = 0; z < layers; ++z){
+            uint64_t *p = ptr + (size_t)z * wordsPerLayer;
+            for(size_t i = 0; i < wordsPerLayer; ++i) p[i] = 0;
+        }
+        for(size_t i = (size_t)layers * wordsPerLayer; i < numWords; ++i) ptr[i] = 0;
+    }
+
+    // Uses numWords words at data, owned by `owner` (e.g. a mapped file),
+    // instead of allocating.
+    void view(uint64_t *data, size_t numWords, std::shared_ptr<void> dataOwner){
+        clear();
+        ptr = data;
+        count = numWords;
+        owner = std::move(dataOwner);
+    }
+
+    void clear(){
+        ptr = nullptr;
+        count = 0;
+        owned.reset();
+        owner.reset();
+    }
+
+    uint64_t* data() { return ptr; }
+    const uint64_t* data() const { return ptr; }
+    size_t size() const { return count; }
+    uint64_t& operator[](size_t i) { return ptr[i]; }
+    const uint64_t& operator[](size_t i) const { return ptr[i]; }
+    uint64_t* begin() { return ptr; }
+    uint64_t* end() { return ptr + count; }
+    const uint64_t* begin() const { return ptr; }
+    const uint64_t* end() const { return ptr + count; }
+};
+
+// Bit rows of numX voxels padded to whole 64-bit words. The padding bits past
+// numX are kept clear in every plane, so rows can be combined and scanned a
+// word at a time (runLabeling::Build relies on this).
+struct bitRow
+{
+    // The valid bits of the last word of a row.
+    static uint64_t TailMask(int numX){
+        return (numX & 63) ? (uint64_t(1) << (numX & 63)) - 1 : ~uint64_t(0);
+    }
+
+    // Sets bits [x0, x1) of a row.
+    static void SetRange(uint64_t *row, int x0, int x1){
+        while (x0 < x1) {
+            const int bit = x0 & 63;
+            const int n = std::min(64 - bit, x1 - x0);
+            row[x0 >> 6] |= (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+            x0 += n;
+        }
+    }
+};
+
+// Voxel labels are stored as two bit planes with one bit per voxel. Each X row
+// is padded to whole 64-bit words so rows can be processed word by word.
+//   surface bit set -> 0 (surface)
+//   outside bit set -> -1 (empty)
+//   neither         -> 1 (inside)
 struct voxGrid
 {
     double origin[3] = {0, 0, 0};
     double spacing[3] = {1, 1, 1};
     int dim[3] = {0, 0, 0};
-    std::vector<int> value; // -1:empty 0:surface 1:inside
+    int wordsPerRow = 0;
+    wordBuffer surface;
+    wordBuffer outside;
 
     ~voxGrid(){
-        value.clear();
-        value.shrink_to_fit();
+        surface.clear();
+        outside.clear();
+    }
+
+    // Sizes both planes from dim and marks every voxel as inside.
+    void allocate(){
+        wordsPerRow = (dim[0] + 63) / 64;
+        size_t wordsPerLayer = (size_t)wordsPerRow * dim[1];
+        surface.allocate(wordsPerLayer * dim[2], wordsPerLayer);
+        outside.allocate(wordsPerLayer * dim[2], wordsPerLayer);
+    }
+
+    size_t numVoxels() const { return (size_t)dim[0] * dim[1] * dim[2]; }
+
+    size_t rowOffset(int y, int z) const { return ((size_t)z * dim[1] + y) * wordsPerRow; }
+
+    uint64_t* surfaceRow(int y, int z) { return surface.data() + rowOffset(y, z); }
+    const uint64_t* surfaceRow(int y, int z) const { return surface.data() + rowOffset(y, z); }
+    uint64_t* outsideRow(int y, int z) { return outside.data() + rowOffset(y, z); }
+    const uint64_t* outsideRow(int y, int z) const { return outside.data() + rowOffset(y, z); }
+
+    bool isSurface(int x, int y, int z) const { return (surfaceRow(y, z)[x >> 6] >> (x & 63)) & 1; }
+    bool isOutside(int x, int y, int z) const { return (outsideRow(y, z)[x >> 6] >> (x & 63)) & 1; }
+
+    void setSurface(int x, int y, int z) { surfaceRow(y, z)[x >> 6] |= uint64_t(1) << (x & 63); }
+    void setOutside(int x, int y, int z) { outsideRow(y, z)[x >> 6] |= uint64_t(1) << (x & 63); }
+
+    // -1:empty 0:surface 1:inside, as any signed Label type
+    template<typename Label = int>
+    Label get(int x, int y, int z) const {
+        size_t w = rowOffset(y, z) + (x >> 6);
+        uint64_t bit = uint64_t(1) << (x & 63);
+        if(surface[w] & bit) return Label(0);
+        if(outside[w] & bit) return Label(-1);
+        return Label(1);
     }
 };
 
+// One float per voxel of a voxGrid, X fastest, that voxWriter writes as an
+// extra cell array next to the labels (e.g. the distances of voxDistance).
+struct voxField
+{
+    std::string name;
+    std::vector<float> values;
+};
+
 #endif
\ No newline at end of file
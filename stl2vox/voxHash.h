@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXHASH_H__
+#define __VOXHASH_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "voxGrid.h"
+
+// Fast non-cryptographic 64-bit hash, consuming 8 bytes per step.
+class voxHash
+{
+private:
+    static uint64_t Mix(uint64_t h){
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+public:
+    static uint64_t Bytes(const void *data, size_t size, uint64_t seed = 0){
+        const unsigned char *p = static_cast<const unsigned char*>(data);
+        uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8){
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            h = (h ^ Mix(w)) * 0x9E3779B97F4A7C15ULL;
+            h = (h << 31) | (h >> 33);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p + i, size - i);
+        return Mix(h ^ Mix(tail ^ (size - i)));
+    }
+
+    static uint64_t Combine(uint64_t a, uint64_t b){
+        return Mix(a ^ (b + 0x9E3779B97F4A7C15ULL + (a << 6) + (a >> 2)));
+    }
+
+    // Identifies the voxel labels and grid geometry of a dense grid.
+    static uint64_t Grid(const voxGrid &grid){
+        uint64_t h = Bytes(grid.dim, sizeof(grid.dim));
+        h = Combine(h, Bytes(grid.origin, sizeof(grid.origin)));
+        h = Combine(h, Bytes(grid.spacing, sizeof(grid.spacing)));
+        h = Combine(h, Bytes(grid.surface.data(), grid.surface.size() * sizeof(uint64_t)));
+        h = Combine(h, Bytes(grid.outside.data(), grid.outside.size() * sizeof(uint64_t)));
+        return h;
+    }
+};
+
+#endif
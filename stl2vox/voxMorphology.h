@@ -0,0 +1,317 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXMORPHOLOGY_H__
+#define __VOXMORPHOLOGY_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "voxGrid.h"
+#include "voxOptions.h"
+
+// Binary morphology on the solid voxels (surface or inside) of a voxGrid.
+// The solid is held as one bit plane with the grid's row layout, and every
+// pass computes each output row from a few input rows (y + dy, z + dz), each
+// widened along X by h voxels with word shifts: OR for dilation, AND for
+// erosion, in parallel over Z layers. Voxels outside the grid count as empty.
+// Large X widths take O(log h) shifts, and the 26-neighbour cube is applied
+// as separate X, Y and Z passes of doubling width.
+//
+// After dilate, erode, open and close the grid is relabeled from the new
+// solid: solid voxels with an empty face neighbour are surface, the others
+// inside. Shell leaves the outside alone and relabels the solid voxels whose
+// distance to the outside (under the element) is at most radius as surface
+// and the rest as inside, so the core of a part is what is left inside.
+class voxMorphology
+{
+private:
+    // Input row (y + dy, z + dz) widened by h voxels along X.
+    struct Offset {
+        int dy;
+        int dz;
+        int h;
+    };
+
+    // Word w of row shifted by s voxels towards higher X (lower for s < 0),
+    // with zeros shifted in.
+    static uint64_t ShiftedWord(const uint64_t *row, int words, int w, int s){
+        if (s >= 0) {
+            const int src = w - (s >> 6), b = s & 63;
+            const uint64_t word = src >= 0 ? row[src] : 0;
+            if (b == 0) return word;
+            return (word << b) | (src - 1 >= 0 ? row[src - 1] >> (64 - b) : 0);
+        }
+        const int src = w + ((-s) >> 6), b = (-s) & 63;
+        const uint64_t word = src < words ? row[src] : 0;
+        if (b == 0) return word;
+        return (word >> b) | (src + 1 < words ? row[src + 1] << (64 - b) : 0);
+    }
+
+    // out = OR (AND when eroding) of row shifted by -h..h. Each round combines
+    // the row with itself shifted by +-step, which extends the covered width
+    // from reach to reach + step, and step may be up to reach + 1.
+    static void WidenRow(const uint64_t *row, uint64_t *out, uint64_t *scratch, int words, int h, bool erode){
+        std::copy(row, row + words, out);
+        for (int reach = 0; reach < h; ) {
+            const int step = std::min(reach + 1, h - reach);
+            std::copy(out, out + words, scratch);
+            if (step < 64) {
+                for (int w = 0; w < words; ++w) {
+                    const uint64_t prev = w > 0 ? scratch[w - 1] : 0;
+                    const uint64_t next = w + 1 < words ? scratch[w + 1] : 0;
+                    const uint64_t a = (scratch[w] << step) | (prev >> (64 - step));
+                    const uint64_t b = (scratch[w] >> step) | (next << (64 - step));
+                    out[w] = erode ? scratch[w] & a & b : scratch[w] | a | b;
+                }
+            } else {
+                for (int w = 0; w < words; ++w) {
+                    const uint64_t a = ShiftedWord(scratch, words, w, step);
+                    const uint64_t b = ShiftedWord(scratch, words, w, -step);
+                    out[w] = erode ? scratch[w] & a & b : scratch[w] | a | b;
+                }
+            }
+            reach += step;
+        }
+    }
+
+    // Source layers widened for every X width of a pass are kept per thread
+    // up to this size; beyond it rows are widened for each use instead.
+    static const size_t windowBytes = size_t(64) << 20;
+
+    // One pass: row (y, z) of out combines the rows (y + dy, z + dz) of in,
+    // each widened by h. Every thread takes a contiguous range of layers and
+    // keeps the widened rows of the layers its current layer reads, so each
+    // source row is widened once per width rather than once per use.
+    static void Pass(const std::vector<uint64_t> &in, std::vector<uint64_t> &out, const voxGrid &grid,
+                     const std::vector<Offset> &offsets, bool erode){
+        const int words = grid.wordsPerRow, numY = grid.dim[1], numZ = grid.dim[2];
+        const uint64_t tail = bitRow::TailMask(grid.dim[0]);
+        const size_t layerWords = (size_t)words * numY;
+        out.resize(in.size());
+
+        // Distinct widths > 0 in increasing order, and the window of layers.
+        std::vector<int> widths;
+        int dz0 = 0, dz1 = 0;
+        for (const Offset &o : offsets) {
+            if (o.h > 0) widths.push_back(o.h);
+            dz0 = std::min(dz0, o.dz);
+            dz1 = std::max(dz1, o.dz);
+        }
+        std::sort(widths.begin(), widths.end());
+        widths.erase(std::unique(widths.begin(), widths.end()), widths.end());
+        std::vector<int> widthIndex(offsets.size(), -1);
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            if (offsets[i].h > 0) widthIndex[i] = (int)(std::lower_bound(widths.begin(), widths.end(), offsets[i].h) - widths.begin());
+        }
+        const int slots = dz1 - dz0 + 1;
+        const bool cached = (size_t)slots * widths.size() * layerWords * sizeof(uint64_t) <= windowBytes;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            std::vector<uint64_t> wide(words), scratch(words);
+            std::vector<uint64_t> window(cached ? (size_t)slots * widths.size() * layerWords : 0);
+            std::vector<int> slotLayer(slots, -1);
+            auto windowRow = [&](int zz, size_t width, int y) {
+                return window.data() + (((size_t)(zz % slots) * widths.size() + width) * numY + y) * words;
+            };
+            auto widenLayer = [&](int zz) {
+                if (slotLayer[zz % slots] == zz) return;
+                slotLayer[zz % slots] = zz;
+                for (int y = 0; y < numY; ++y) {
+                    const uint64_t *src = in.data() + grid.rowOffset(y, zz);
+                    for (size_t i = 0; i < widths.size(); ++i) {
+                        uint64_t *dst = windowRow(zz, i, y);
+                        WidenRow(i == 0 ? src : windowRow(zz, i - 1, y), dst, scratch.data(), words,
+                                 widths[i] - (i == 0 ? 0 : widths[i - 1]), erode);
+                    }
+                }
+            };
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (int z = 0; z < numZ; ++z) {
+                if (cached) {
+                    for (int zz = std::max(0, z + dz0); zz <= std::min(numZ - 1, z + dz1); ++zz) widenLayer(zz);
+                }
+                for (int y = 0; y < numY; ++y) {
+                    uint64_t *dst = out.data() + grid.rowOffset(y, z);
+                    std::fill(dst, dst + words, erode ? ~uint64_t(0) : 0);
+                    for (size_t i = 0; i < offsets.size(); ++i) {
+                        const Offset &o = offsets[i];
+                        const int yy = y + o.dy, zz = z + o.dz;
+                        if (yy < 0 || yy >= numY || zz < 0 || zz >= numZ) {
+                            if (!erode) continue;
+                            std::fill(dst, dst + words, 0);
+                            break;
+                        }
+                        const uint64_t *src = in.data() + grid.rowOffset(yy, zz);
+                        // Empty rows add nothing to a dilation, and an eroded
+                        // row that is already empty stays so.
+                        if (!erode && std::all_of(src, src + words, [](uint64_t w) { return w == 0; })) continue;
+                        if (o.h > 0 && cached) {
+                            src = windowRow(zz, widthIndex[i], yy);
+                        } else if (o.h > 0) {
+                            WidenRow(src, wide.data(), scratch.data(), words, o.h, erode);
+                            src = wide.data();
+                        }
+                        uint64_t any = 0;
+                        for (int w = 0; w < words; ++w) {
+                            dst[w] = erode ? dst[w] & src[w] : dst[w] | src[w];
+                            any |= dst[w];
+                        }
+                        if (erode && any == 0) break;
+                    }
+                    dst[words - 1] &= tail;
+                }
+            }
+        }
+    }
+
+    // Offsets of one application of element (radius 1), or of the ball of
+    // the given radius for MorphElement::Sphere.
+    static std::vector<Offset> Element(MorphElement element, int radius){
+        std::vector<Offset> offsets;
+        if (element == MorphElement::Sphere) {
+            for (int dz = -radius; dz <= radius; ++dz) {
+                for (int dy = -radius; dy <= radius; ++dy) {
+                    const int rest = radius * radius - dy * dy - dz * dz;
+                    if (rest >= 0) offsets.push_back({ dy, dz, (int)std::sqrt((double)rest) });
+                }
+            }
+            return offsets;
+        }
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                // The 6 neighbours reach along X only in the row itself, the
+                // 18 also in the rows one step away in Y or Z, and the 26 in
+                // all nine rows; the 6 skip the diagonal rows.
+                const int away = std::abs(dy) + std::abs(dz);
+                if (element == MorphElement::Face && away == 2) continue;
+                const bool center = (element == MorphElement::Face && away == 1) ||
+                                    (element == MorphElement::Edge && away == 2);
+                offsets.push_back({ dy, dz, center ? 0 : 1 });
+            }
+        }
+        return offsets;
+    }
+
+    // Dilates or erodes solid by element applied radius times.
+    static void Morph(std::vector<uint64_t> &solid, const voxGrid &grid, MorphElement element, int radius, bool erode){
+        std::vector<uint64_t> next;
+        auto pass = [&](const std::vector<Offset> &offsets) {
+            Pass(solid, next, grid, offsets, erode);
+            solid.swap(next);
+        };
+        if (element == MorphElement::Sphere) {
+            pass(Element(element, radius));
+        } else if (element == MorphElement::Vertex) {
+            // The cube is separable: X, then Y and Z with doubling steps.
+            pass({ { 0, 0, radius } });
+            for (int axis = 0; axis < 2; ++axis) {
+                for (int reach = 0; reach < radius; ) {
+                    const int step = std::min(reach + 1, radius - reach);
+                    if (axis == 0) pass({ { 0, 0, 0 }, { -step, 0, 0 }, { step, 0, 0 } });
+                    else pass({ { 0, 0, 0 }, { 0, -step, 0 }, { 0, step, 0 } });
+                    reach += step;
+                }
+            }
+        } else {
+            const std::vector<Offset> offsets = Element(element, 1);
+            for (int i = 0; i < radius; ++i) pass(offsets);
+        }
+    }
+
+    static void Solid(const voxGrid &grid, std::vector<uint64_t> &solid){
+        const int words = grid.wordsPerRow;
+        const uint64_t tail = bitRow::TailMask(grid.dim[0]);
+        solid.resize(grid.outside.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long i = 0; i < (long long)solid.size(); ++i) {
+            solid[i] = ~grid.outside[i] & ((i % words) == words - 1 ? tail : ~uint64_t(0));
+        }
+    }
+
+    // Sets the planes to outside = ~solid, surface = solid & ~core. They are
+    // allocated anew, as the grid may be a read-only view of a cache entry.
+    static void Relabel(voxGrid &grid, const std::vector<uint64_t> &solid, const std::vector<uint64_t> &core){
+        grid.allocate();
+        const int words = grid.wordsPerRow;
+        const uint64_t tail = bitRow::TailMask(grid.dim[0]);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long i = 0; i < (long long)solid.size(); ++i) {
+            grid.outside[i] = ~solid[i] & ((i % words) == words - 1 ? tail : ~uint64_t(0));
+            grid.surface[i] = solid[i] & ~core[i];
+        }
+    }
+
+public:
+    static void Apply(voxGrid &grid, const morphStep &step){
+        std::vector<uint64_t> solid;
+        Solid(grid, solid);
+        switch (step.op) {
+            case MorphOp::Dilate: Morph(solid, grid, step.element, step.radius, false); break;
+            case MorphOp::Erode:  Morph(solid, grid, step.element, step.radius, true); break;
+            case MorphOp::Open:
+                Morph(solid, grid, step.element, step.radius, true);
+                Morph(solid, grid, step.element, step.radius, false);
+                break;
+            case MorphOp::Close:
+                Morph(solid, grid, step.element, step.radius, false);
+                Morph(solid, grid, step.element, step.radius, true);
+                break;
+            case MorphOp::Shell: {
+                std::vector<uint64_t> core = solid;
+                Morph(core, grid, step.element, step.radius, true);
+                Relabel(grid, solid, core);
+                return;
+            }
+        }
+        std::vector<uint64_t> core = solid;
+        Morph(core, grid, MorphElement::Face, 1, true);
+        Relabel(grid, solid, core);
+    }
+
+    static void Apply(voxGrid &grid, const std::vector<morphStep> &steps){
+        for (const morphStep &step : steps) Apply(grid, step);
+    }
+};
+
+#endif
@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXOPTIONS_H__
+#define __VOXOPTIONS_H__
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct voxStats;
+
+// How surface voxels are rasterized.
+//   Triangles: one task per triangle, concurrent writes are merged with atomics.
+//   Slabs:     triangles are binned into Z slabs and each task owns one slab,
+//              so writes stay local, need no atomics and are deterministic.
+enum class RasterMode { Triangles, Slabs };
+
+// How voxels that are not surface are split into inside and outside.
+//   Flood:  outside is what a flood fill from the grid boundary reaches.
+//   Parity: inside is decided per voxel by ray crossing parity along X, Y and
+//           Z with a majority vote (see voxParity); tolerates small holes.
+enum class FillMode { Flood, Parity };
+
+// Scalar type of the per-voxel triangle/box tests (see TriBoxTest::RowMask).
+// Triangles are set up in double either way; Float tests twice as many voxels
+// per vector instruction and may differ from Double only for voxels that
+// touch a triangle to within float rounding.
+enum class Precision { Double, Float };
+
+// Which part a voxel claimed by several parts of an assembly goes to (see
+// voxAssembly): the part listed last or first, or the one with the highest or
+// lowest material ID.
+enum class OverlapRule { Last, First, MaxMaterial, MinMaterial };
+
+// Morphology on the solid (surface and inside) voxels of a converted grid,
+// see voxMorphology. Shell keeps the voxels within radius of the outside as
+// surface and the rest of the solid as inside.
+enum class MorphOp { Dilate, Erode, Open, Close, Shell };
+
+// Structuring elements: the 6, 18 or 26 neighbours of a voxel, applied radius
+// times, or the ball of voxel centers within radius.
+enum class MorphElement { Face, Edge, Vertex, Sphere };
+
+struct morphStep
+{
+    MorphOp op;
+    int radius;
+    MorphElement element;
+};
+
+// Output file formats, see voxWriter.
+enum class voxFormat { VTKAscii, VTKBinary, VTIRaw, VTIZlib, Rle };
+
+struct voxOptions
+{
+    int dim[3] = {0, 0, 0}; // voxels per axis, 0 asks on stdin
+    double voxelSize = 0;   // cubic voxels of this edge length instead of dim, 0 for none
+    uint64_t memoryBudget = 0; // refuse grids estimated to need more bytes; alone, fit the finest cubic grid in it
+    bool downgrade = false; // coarsen grids over memoryBudget until they fit instead of refusing them
+    bool estimateOnly = false; // print the pre-flight estimate of each file without converting it
+    RasterMode raster = RasterMode::Slabs;
+    FillMode fill = FillMode::Flood;
+    Precision precision = Precision::Double;
+    OverlapRule overlap = OverlapRule::Last;
+    int slabDepth = 0;      // Z layers per slab, 0 picks one from the thread count
+    bool sparse = false;    // use sparseGrid instead of voxGrid
+    bool indexed = false;   // load a welded float32 IndexedMesh instead of an STLMesh
+    int sdfBand = 0;        // also write signed distances, exact within this many voxels of the surface; 0 for none
+    int levels = 1;         // resolution levels written, each half as fine as the previous
+    std::vector<morphStep> morph; // applied in order to the converted grid
+    bool components = false; // also write the IDs and table of bodies and cavities, see voxComponents
+    bool stream = false;    // write the grid slab by slab without holding it in memory
+    int streamDepth = 0;    // Z layers per streamed slab, 0 keeps a slab near 256 MiB
+    bool verbose = true;    // print per-stage messages
+    voxStats *stats = nullptr; // timings and counters are recorded here when set
+
+    voxFormat format = voxFormat::VTKBinary;
+    std::string outputDir;  // write next to the input when empty
+    int jobs = 1;           // files voxelized concurrently in batch mode
+
+    std::string cacheDir;   // reuse dense grids stored here, no cache when empty
+    uint64_t cacheBytes = uint64_t(4) << 30; // size limit of the cache directory
+
+    // Names used on the command line and by voxServer requests.
+    static voxFormat ParseFormat(const std::string &name){
+        if (name == "vtk") return voxFormat::VTKBinary;
+        if (name == "vtk-ascii") return voxFormat::VTKAscii;
+        if (name == "vti") return voxFormat::VTIRaw;
+        if (name == "vti-zlib") return voxFormat::VTIZlib;
+        if (name == "rle") return voxFormat::Rle;
+        throw std::runtime_error("Unknown format: " + name);
+    }
+
+    static RasterMode ParseRaster(const std::string &name){
+        if (name == "slabs") return RasterMode::Slabs;
+        if (name == "triangles") return RasterMode::Triangles;
+        throw std::runtime_error("Unknown raster mode: " + name);
+    }
+
+    static FillMode ParseFill(const std::string &name){
+        if (name == "flood") return FillMode::Flood;
+        if (name == "parity") return FillMode::Parity;
+        throw std::runtime_error("Unknown fill mode: " + name);
+    }
+
+    static Precision ParsePrecision(const std::string &name){
+        if (name == "double") return Precision::Double;
+        if (name == "float") return Precision::Float;
+        throw std::runtime_error("Unknown precision: " + name);
+    }
+
+    // Comma-separated OP:RADIUS[:ELEMENT] steps, e.g. "close:2:sphere,shell:3",
+    // with OP dilate, erode, open, close or shell and ELEMENT 6 (default), 18,
+    // 26 or sphere.
+    static std::vector<morphStep> ParseMorph(const std::string &text){
+        std::vector<morphStep> steps;
+        size_t begin = 0;
+        while (begin <= text.size()) {
+            size_t end = text.find(',', begin);
+            if (end == std::string::npos) end = text.size();
+            const std::string item = text.substr(begin, end - begin);
+            const size_t c1 = item.find(':');
+            const size_t c2 = c1 == std::string::npos ? c1 : item.find(':', c1 + 1);
+            if (c1 == std::string::npos) throw std::runtime_error("Expected OP:RADIUS[:ELEMENT] in --morph: " + item);
+
+            const std::string op = item.substr(0, c1);
+            morphStep step;
+            if (op == "dilate") step.op = MorphOp::Dilate;
+            else if (op == "erode") step.op = MorphOp::Erode;
+            else if (op == "open") step.op = MorphOp::Open;
+            else if (op == "close") step.op = MorphOp::Close;
+            else if (op == "shell") step.op = MorphOp::Shell;
+            else throw std::runtime_error("Unknown morphology operation: " + op);
+
+            const std::string radius = item.substr(c1 + 1, c2 == std::string::npos ? std::string::npos : c2 - c1 - 1);
+            char *stop = nullptr;
+            const long value = std::strtol(radius.c_str(), &stop, 10);
+            if (radius.empty() || *stop != '\0' || value < 1 || value > 1024) {
+                throw std::runtime_error("Invalid morphology radius: " + radius);
+            }
+            step.radius = (int)value;
+
+            const std::string element = c2 == std::string::npos ? "6" : item.substr(c2 + 1);
+            if (element == "6") step.element = MorphElement::Face;
+            else if (element == "18") step.element = MorphElement::Edge;
+            else if (element == "26") step.element = MorphElement::Vertex;
+            else if (element == "sphere") step.element = MorphElement::Sphere;
+            else throw std::runtime_error("Unknown structuring element: " + element);
+
+            steps.push_back(step);
+            begin = end + 1;
+        }
+        return steps;
+    }
+
+    static OverlapRule ParseOverlap(const std::string &name){
+        if (name == "last") return OverlapRule::Last;
+        if (name == "first") return OverlapRule::First;
+        if (name == "max") return OverlapRule::MaxMaterial;
+        if (name == "min") return OverlapRule::MinMaterial;
+        throw std::runtime_error("Unknown overlap rule: " + name);
+    }
+};
+
+#endif
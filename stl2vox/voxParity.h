@@ -0,0 +1,342 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXPARITY_H__
+#define __VOXPARITY_H__
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stlMesh.h"
+#include "voxGrid.h"
+
+// Inside/outside classification by ray parity, an alternative to the flood
+// fill of stl2vox::ComfirmOutsideVoxels. Rays are cast along X, Y and Z
+// through the voxel centers of every column; a free voxel is inside along one
+// axis when its ray crosses the mesh an odd number of times before its center,
+// and inside when at least two of the three axes agree. Columns are
+// independent, and a hole in the mesh only spoils the rays through it instead
+// of letting the whole interior leak out.
+class voxParity
+{
+public:
+    struct Counters {
+        size_t crossings = 0;    // ray/triangle crossings
+        size_t openColumns = 0;  // rays with an odd number of crossings
+    };
+
+    // Ray of column u crossing the mesh before the center of voxel k.
+    struct Crossing {
+        int u;
+        int k;
+        bool operator<(const Crossing &other) const {
+            return u != other.u ? u < other.u : k < other.k;
+        }
+    };
+
+    // Voxels [k0, k1) of column u are inside.
+    struct Span {
+        int u;
+        int k0;
+        int k1;
+    };
+
+private:
+    // Triangles whose projection along the rays spans a voxel center, listed
+    // per row v of columns (row v owns indices[offsets[v] .. offsets[v+1])).
+    struct RowBins {
+        std::vector<size_t> offsets;
+        std::vector<uint32_t> indices;
+    };
+
+    static double Coord(const Vector3d &p, int axis){
+        return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+    }
+
+    // First and last voxel whose center lies in [lo, hi] along axis.
+    static int FirstCenter(const voxGrid &grid, int axis, double lo){
+        return std::max(0, (int)std::ceil((lo - grid.origin[axis]) / grid.spacing[axis] - 0.5));
+    }
+
+    static int LastCenter(const voxGrid &grid, int axis, double hi){
+        return std::min(grid.dim[axis] - 1, (int)std::floor((hi - grid.origin[axis]) / grid.spacing[axis] - 0.5));
+    }
+
+    // Side of q against the edge a-b in the projection plane, as if q were
+    // moved by (e, e^2) for an infinitesimal e, so it is never zero. Edges are
+    // evaluated from their lexicographically smaller end, so the triangles on
+    // both sides of an edge see the same value and a ray through an edge or a
+    // vertex crosses exactly one of the triangles around it.
+    static double EdgeSide(const double a[2], const double b[2], const double q[2]){
+        const bool flip = b[0] < a[0] || (b[0] == a[0] && b[1] < a[1]);
+        const double *s = flip ? b : a;
+        const double *e = flip ? a : b;
+        const double ex = e[0] - s[0], ey = e[1] - s[1];
+        double side = ex * (q[1] - s[1]) - ey * (q[0] - s[0]);
+        if (side == 0) side = ey != 0 ? -ey : ex;
+        return flip ? -side : side;
+    }
+
+    template<typename Mesh>
+    static void BinTriangles(const Mesh &mesh, const voxGrid &grid, int u, int v, RowBins &bins){
+        const long long triCount = (long long)mesh.size();
+        std::vector<int> first(triCount), last(triCount);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (long long t = 0; t < triCount; ++t) {
+            double lo[3], hi[3];
+            mesh.bounds(t, lo, hi);
+            first[t] = FirstCenter(grid, v, lo[v]);
+            last[t] = LastCenter(grid, v, hi[v]);
+            if (FirstCenter(grid, u, lo[u]) > LastCenter(grid, u, hi[u])) last[t] = first[t] - 1;
+        }
+
+        const int numRows = grid.dim[v];
+        bins.offsets.assign(numRows + 1, 0);
+        for (long long t = 0; t < triCount; ++t) {
+            for (int r = first[t]; r <= last[t]; ++r) ++bins.offsets[r + 1];
+        }
+        for (int r = 0; r < numRows; ++r) bins.offsets[r + 1] += bins.offsets[r];
+
+        std::vector<size_t> cursor(bins.offsets.begin(), bins.offsets.end() - 1);
+        bins.indices.resize(bins.offsets.back());
+        for (long long t = 0; t < triCount; ++t) {
+            for (int r = first[t]; r <= last[t]; ++r) bins.indices[cursor[r]++] = (uint32_t)t;
+        }
+    }
+
+    // Casts the rays along axis a of every row of columns across axis v, in
+    // parallel over rows, and calls finish(row, spans) with the inside runs of
+    // that row. Rays with an odd number of crossings give no spans.
+    template<typename Mesh, typename Finish>
+    static void CastRays(const Mesh &mesh, const voxGrid &grid, int a, int v, Finish &&finish, Counters &counters){
+        RowBins bins;
+        BinTriangles(mesh, grid, 3 - a - v, v, bins);
+
+        const int numRows = grid.dim[v];
+        size_t crossings = 0, openColumns = 0;
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:crossings, openColumns)
+#endif
+        {
+            std::vector<Crossing> hits;
+            std::vector<Span> spans;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+            for (int row = 0; row < numRows; ++row) {
+                RowCrossings(mesh, grid, a, v, row, bins.indices.data() + bins.offsets[row],
+                             bins.indices.data() + bins.offsets[row + 1], hits);
+                openColumns += RowSpans(hits, spans);
+                crossings += hits.size();
+                finish(row, spans);
+            }
+        }
+        counters.crossings += crossings;
+        counters.openColumns += openColumns;
+    }
+
+public:
+    // Crossings of the rays along axis a of row `row` (across axis v) with the
+    // triangles [first, last), which must include every triangle the rays
+    // cross; others are skipped.
+    template<typename Mesh>
+    static void RowCrossings(const Mesh &mesh, const voxGrid &grid, int a, int v, int row,
+                             const uint32_t *first, const uint32_t *last, std::vector<Crossing> &hits){
+        const int u = 3 - a - v;
+        const int length = grid.dim[a];
+        const double rowCenter = grid.origin[v] + (row + 0.5) * grid.spacing[v];
+        hits.clear();
+        for (const uint32_t *it = first; it != last; ++it) {
+            const size_t t = *it;
+            const Triangle &triangle = mesh.triangle(t);
+            const Vector3d *corner[3] = { &triangle.v0, &triangle.v1, &triangle.v2 };
+            double p[3][2], h[3];
+            for (int c = 0; c < 3; ++c) {
+                p[c][0] = Coord(*corner[c], u);
+                p[c][1] = Coord(*corner[c], v);
+                h[c] = Coord(*corner[c], a);
+            }
+            const double e1[2] = { p[1][0] - p[0][0], p[1][1] - p[0][1] };
+            const double e2[2] = { p[2][0] - p[0][0], p[2][1] - p[0][1] };
+            const double area = e1[0] * e2[1] - e1[1] * e2[0];
+            if (area == 0) continue; // parallel to the rays
+
+            double lo[3], hi[3];
+            mesh.bounds(t, lo, hi);
+            const int c1 = LastCenter(grid, u, hi[u]);
+            for (int col = FirstCenter(grid, u, lo[u]); col <= c1; ++col) {
+                const double q[2] = { grid.origin[u] + (col + 0.5) * grid.spacing[u], rowCenter };
+                const double s0 = EdgeSide(p[0], p[1], q);
+                const double s1 = EdgeSide(p[1], p[2], q);
+                const double s2 = EdgeSide(p[2], p[0], q);
+                if (!((s0 > 0 && s1 > 0 && s2 > 0) || (s0 < 0 && s1 < 0 && s2 < 0))) continue;
+
+                // Height of the triangle's plane over q along a.
+                const double du = q[0] - p[0][0], dv = q[1] - p[0][1];
+                const double alpha = (du * e2[1] - dv * e2[0]) / area;
+                const double beta = (e1[0] * dv - e1[1] * du) / area;
+                const double height = h[0] + alpha * (h[1] - h[0]) + beta * (h[2] - h[0]);
+                const double k = std::floor((height - grid.origin[a]) / grid.spacing[a] - 0.5) + 1;
+                hits.push_back({ col, (int)std::max(0.0, std::min((double)length, k)) });
+            }
+        }
+    }
+
+    // Sorts hits and replaces spans with the inside runs of the row. Returns
+    // the number of rays with an odd number of crossings, which give no spans.
+    static size_t RowSpans(std::vector<Crossing> &hits, std::vector<Span> &spans){
+        size_t openColumns = 0;
+        spans.clear();
+        std::sort(hits.begin(), hits.end());
+        for (size_t i = 0; i < hits.size();) {
+            size_t j = i;
+            while (j < hits.size() && hits[j].u == hits[i].u) ++j;
+            if ((j - i) % 2 != 0) {
+                ++openColumns;
+            } else {
+                for (size_t k = i; k < j; k += 2) {
+                    if (hits[k].k < hits[k + 1].k) spans.push_back({ hits[k].u, hits[k].k, hits[k + 1].k });
+                }
+            }
+            i = j;
+        }
+        return openColumns;
+    }
+
+    // Whether the ray along axis a through the center of each voxel (x, y, z)
+    // crosses the mesh an odd number of times before reaching that center, in
+    // parallel over the rows of rays the voxels lie in.
+    template<typename Mesh>
+    static std::vector<uint8_t> InsideAlong(const Mesh &mesh, const voxGrid &grid, int a,
+                                            const std::vector<std::array<int, 3>> &voxels){
+        std::vector<uint8_t> inside(voxels.size(), 0);
+        if (voxels.empty()) return inside;
+        const int v = a == 2 ? 1 : 2;
+        const int u = 3 - a - v;
+        RowBins bins;
+        BinTriangles(mesh, grid, u, v, bins);
+
+        std::vector<size_t> order(voxels.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t i, size_t j) { return voxels[i][v] < voxels[j][v]; });
+        std::vector<size_t> rowStart;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (i == 0 || voxels[order[i]][v] != voxels[order[i - 1]][v]) rowStart.push_back(i);
+        }
+        rowStart.push_back(order.size());
+
+        const long long numRows = (long long)rowStart.size() - 1;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            std::vector<Crossing> hits;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+            for (long long r = 0; r < numRows; ++r) {
+                const int row = voxels[order[rowStart[r]]][v];
+                RowCrossings(mesh, grid, a, v, row, bins.indices.data() + bins.offsets[row],
+                             bins.indices.data() + bins.offsets[row + 1], hits);
+                std::sort(hits.begin(), hits.end());
+                for (size_t i = rowStart[r]; i < rowStart[r + 1]; ++i) {
+                    const std::array<int, 3> &voxel = voxels[order[i]];
+                    const auto first = std::lower_bound(hits.begin(), hits.end(), Crossing{ voxel[u], 0 });
+                    const auto last = std::upper_bound(first, hits.end(), Crossing{ voxel[u], voxel[a] });
+                    inside[order[i]] = (last - first) % 2;
+                }
+            }
+        }
+        return inside;
+    }
+
+    // Sets the outside plane of grid from its surface plane and the mesh:
+    // every voxel that is neither surface nor inside by the majority vote.
+    template<typename Mesh>
+    static Counters Classify(const Mesh &mesh, voxGrid &grid){
+        const int wordsPerRow = grid.wordsPerRow;
+        const int numX = grid.dim[0], numY = grid.dim[1], numZ = grid.dim[2];
+        const size_t wordsPerLayer = (size_t)wordsPerRow * numY;
+        Counters counters;
+
+        // X rays, one row of columns per Z layer: the vote goes straight into
+        // the outside plane.
+        CastRays(mesh, grid, 0, 2, [&](int z, const std::vector<Span> &spans) {
+            std::fill(grid.outsideRow(0, z), grid.outsideRow(0, z) + wordsPerLayer, 0);
+            for (const Span &span : spans) bitRow::SetRange(grid.outsideRow(span.u, z), span.k0, span.k1);
+        }, counters);
+
+        // Y rays per Z layer: the outside plane keeps X and Y, either keeps X or Y.
+        std::vector<uint64_t> either(grid.outside.size());
+        CastRays(mesh, grid, 1, 2, [&](int z, const std::vector<Span> &spans) {
+            std::vector<uint64_t> vote(wordsPerLayer, 0);
+            for (const Span &span : spans) {
+                const uint64_t bit = uint64_t(1) << (span.u & 63);
+                for (int y = span.k0; y < span.k1; ++y) vote[(size_t)y * wordsPerRow + (span.u >> 6)] |= bit;
+            }
+            uint64_t *both = grid.outsideRow(0, z);
+            uint64_t *any = either.data() + grid.rowOffset(0, z);
+            for (size_t i = 0; i < wordsPerLayer; ++i) {
+                any[i] = both[i] | vote[i];
+                both[i] &= vote[i];
+            }
+        }, counters);
+
+        // Z rays per Y row, then the majority of the three votes.
+        const uint64_t lastMask = bitRow::TailMask(numX);
+        CastRays(mesh, grid, 2, 1, [&](int y, const std::vector<Span> &spans) {
+            std::vector<uint64_t> vote((size_t)wordsPerRow * numZ, 0);
+            for (const Span &span : spans) {
+                const uint64_t bit = uint64_t(1) << (span.u & 63);
+                for (int z = span.k0; z < span.k1; ++z) vote[(size_t)z * wordsPerRow + (span.u >> 6)] |= bit;
+            }
+            for (int z = 0; z < numZ; ++z) {
+                uint64_t *out = grid.outsideRow(y, z);
+                const uint64_t *surf = grid.surfaceRow(y, z);
+                const uint64_t *any = either.data() + grid.rowOffset(y, z);
+                const uint64_t *zVote = vote.data() + (size_t)z * wordsPerRow;
+                for (int w = 0; w < wordsPerRow; ++w) {
+                    const uint64_t inside = out[w] | (any[w] & zVote[w]);
+                    out[w] = ~(inside | surf[w]) & (w == wordsPerRow - 1 ? lastMask : ~uint64_t(0));
+                }
+            }
+        }, counters);
+
+        return counters;
+    }
+};
+
+#endif
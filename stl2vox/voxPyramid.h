@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXPYRAMID_H__
+#define __VOXPYRAMID_H__
+
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "voxGrid.h"
+
+// Coarser levels of a dense grid. Each coarse voxel covers 2x2x2 voxels of
+// the level below and is labelled
+//   surface if any of the eight is surface,
+//   outside if at least five of the eight are outside,
+//   inside  otherwise (a 4/4 tie counts as inside).
+// Levels share the origin and double the spacing, so they nest exactly when
+// the finest dims are multiples of 2^(levels-1) (see stl2vox::LevelAlignment).
+class voxPyramid
+{
+private:
+    // Reduces 64 fine voxels of two rows in two layers to 32 coarse voxels.
+    static void ReduceWord(const uint64_t s[4], const uint64_t o[4], uint32_t &surface, uint32_t &outside){
+        const uint64_t anySurface = s[0] | s[1] | s[2] | s[3];
+        const uint64_t allOutside = o[0] & o[1] & o[2] & o[3];
+        const uint64_t anyOutside = o[0] | o[1] | o[2] | o[3];
+        surface = 0;
+        outside = 0;
+        if (anySurface == 0 && anyOutside == 0) return;
+        // Padding bits past dim[0] are clear, so a partial last word never
+        // takes this shortcut.
+        if (anySurface == 0 && allOutside == ~uint64_t(0)) {
+            outside = ~uint32_t(0);
+            return;
+        }
+
+        for (int k = 0; k < 32; ++k) {
+            const int b = 2 * k;
+            if ((anySurface >> b) & 3) {
+                surface |= uint32_t(1) << k;
+                continue;
+            }
+            const uint64_t pairs = ((o[0] >> b) & 3) | (((o[1] >> b) & 3) << 2) |
+                                   (((o[2] >> b) & 3) << 4) | (((o[3] >> b) & 3) << 6);
+            if (__builtin_popcountll(pairs) >= 5) outside |= uint32_t(1) << k;
+        }
+    }
+
+public:
+    // Fills coarse with the reduction of fine; fine dims must be even.
+    static void Reduce(const voxGrid &fine, voxGrid &coarse){
+        for (int k = 0; k < 3; ++k) {
+            if (fine.dim[k] % 2 != 0) {
+                throw std::runtime_error("Pyramid levels need even grid dims");
+            }
+            coarse.dim[k] = fine.dim[k] / 2;
+            coarse.origin[k] = fine.origin[k];
+            coarse.spacing[k] = fine.spacing[k] * 2;
+        }
+        coarse.allocate();
+
+        const int numY = coarse.dim[1];
+        const int numZ = coarse.dim[2];
+        const int fineWords = fine.wordsPerRow;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int z = 0; z < numZ; ++z) {
+            for (int y = 0; y < numY; ++y) {
+                const uint64_t *surf[4], *out[4];
+                for (int i = 0; i < 4; ++i) {
+                    surf[i] = fine.surfaceRow(2 * y + (i & 1), 2 * z + (i >> 1));
+                    out[i] = fine.outsideRow(2 * y + (i & 1), 2 * z + (i >> 1));
+                }
+                uint64_t *coarseSurf = coarse.surfaceRow(y, z);
+                uint64_t *coarseOut = coarse.outsideRow(y, z);
+                for (int w = 0; w < fineWords; ++w) {
+                    const uint64_t s[4] = { surf[0][w], surf[1][w], surf[2][w], surf[3][w] };
+                    const uint64_t o[4] = { out[0][w], out[1][w], out[2][w], out[3][w] };
+                    uint32_t cs, co;
+                    ReduceWord(s, o, cs, co);
+                    const int shift = (w & 1) * 32;
+                    coarseSurf[w >> 1] |= (uint64_t)cs << shift;
+                    coarseOut[w >> 1] |= (uint64_t)co << shift;
+                }
+            }
+        }
+    }
+};
+
+#endif
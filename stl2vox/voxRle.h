@@ -0,0 +1,407 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXRLE_H__
+#define __VOXRLE_H__
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "voxGrid.h"
+#include "mappedFile.h"
+
+// Compact label file (.vrle). X rows are run-length coded and grouped into
+// slabs of Z layers that are coded independently and located through an
+// index, so slabs are encoded and decoded in parallel and a sub-box only
+// decodes the slabs it overlaps. Integers are in host byte order (files move
+// between little-endian hosts).
+//
+//   header   128 bytes, see voxRle::Header
+//   slabs    numSlabs coded slabs, back to back
+//   index    numSlabs + 1 uint64 file offsets; slab s is [index[s], index[s + 1])
+//
+// A slab codes its rows in Y then Z order. A row is a sequence of tokens
+// varint(n << 2 | code): code 0, 1, 2 is a run of n voxels labelled -1, 0, 1,
+// and the runs of a row add up to dim[0]. Code 3 in place of a row repeats
+// the previous row of the slab n times. Varints are LEB128.
+class voxRle
+{
+public:
+    struct Header {
+        char magic[8];          // "STL2VRLE"
+        uint32_t version;
+        uint32_t slabDepth;     // Z layers per slab, the last slab may be thinner
+        int32_t dim[3];
+        uint32_t numSlabs;
+        double origin[3];
+        double spacing[3];
+        uint64_t indexOffset;
+        char reserved[40];
+    };
+    static_assert(sizeof(Header) == 128, "the header has a fixed size");
+
+    static const uint32_t version = 1;
+    static const int defaultSlabDepth = 8;
+
+    static int NumSlabs(int numZ, int slabDepth){
+        return (numZ + slabDepth - 1) / slabDepth;
+    }
+
+    // Codes `layers` layers of int8 labels (X fastest) and appends them to out.
+    static void EncodeSlab(const int8_t *labels, int numX, int numY, int layers, std::string &out){
+        const size_t rows = (size_t)numY * layers;
+        const int8_t *previous = nullptr;
+        uint64_t repeats = 0;
+        for (size_t r = 0; r < rows; ++r) {
+            const int8_t *row = labels + r * numX;
+            if (previous && std::memcmp(row, previous, numX) == 0) {
+                ++repeats;
+                continue;
+            }
+            if (repeats > 0) PutVarint(repeats << 2 | 3, out);
+            repeats = 0;
+            for (int x = 0; x < numX; ) {
+                const int8_t label = row[x];
+                const uint64_t repeated = (uint64_t)(uint8_t)label * 0x0101010101010101ULL;
+                int end = x + 1;
+                // Eight voxels at a time through the long runs.
+                for (uint64_t word; end + 8 <= numX; end += 8) {
+                    std::memcpy(&word, row + end, sizeof(word));
+                    if (word != repeated) break;
+                }
+                while (end < numX && row[end] == label) ++end;
+                PutVarint((uint64_t)(end - x) << 2 | (uint64_t)(label + 1), out);
+                x = end;
+            }
+            previous = row;
+        }
+        if (repeats > 0) PutVarint(repeats << 2 | 3, out);
+    }
+
+    // Decodes slab data [p, end) of `layers` layers and calls
+    // row(y, z, runs, count) for each row, z relative to the slab, where runs
+    // holds count (label, length) pairs. Throws on malformed data.
+    template<typename Row>
+    static void DecodeSlab(const char *p, const char *end, int numX, int numY, int layers, Row &&row){
+        std::vector<std::pair<int8_t, int>> runs, last;
+        const size_t rows = (size_t)numY * layers;
+        size_t r = 0;
+        while (r < rows) {
+            const char *start = p;
+            const uint64_t token = GetVarint(p, end);
+            if ((token & 3) == 3) {
+                const uint64_t n = token >> 2;
+                if (r == 0 || n == 0 || n > rows - r) Corrupt();
+                for (uint64_t i = 0; i < n; ++i, ++r) {
+                    row((int)(r % numY), (int)(r / numY), last.data(), last.size());
+                }
+                continue;
+            }
+            p = start;
+            runs.clear();
+            int x = 0;
+            while (x < numX) {
+                const uint64_t run = GetVarint(p, end);
+                const uint64_t length = run >> 2;
+                if ((run & 3) == 3 || length == 0 || length > (uint64_t)(numX - x)) Corrupt();
+                runs.emplace_back((int8_t)((int)(run & 3) - 1), (int)length);
+                x += (int)length;
+            }
+            row((int)(r % numY), (int)(r / numY), runs.data(), runs.size());
+            runs.swap(last);
+            ++r;
+        }
+        if (p != end) Corrupt();
+    }
+
+    [[noreturn]] static void Corrupt(){
+        throw std::runtime_error("Corrupt RLE voxel file");
+    }
+
+private:
+    static void PutVarint(uint64_t value, std::string &out){
+        while (value >= 0x80) {
+            out += (char)(value | 0x80);
+            value >>= 7;
+        }
+        out += (char)value;
+    }
+
+    static uint64_t GetVarint(const char *&p, const char *end){
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) Corrupt();
+            const uint8_t byte = (uint8_t)*p++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        Corrupt();
+    }
+};
+
+// Writes a .vrle file layer by layer. Layers may arrive in pieces of any
+// thickness (whole grids or streamed slabs); complete slabs are encoded in
+// parallel and the index is written by close().
+class voxRleWriter
+{
+private:
+    std::ofstream file;
+    std::string outputfile;
+    voxRle::Header header;
+    std::vector<uint64_t> index;
+    std::vector<int8_t> pending;    // labels of the layers of an incomplete slab
+    int pendingLayers = 0;
+    int layersWritten = 0;
+
+    size_t LayerVoxels() const { return (size_t)header.dim[0] * header.dim[1]; }
+
+    // Encodes numSlabs slabs of labels (the last one may be thinner) and appends them.
+    void WriteSlabs(const int8_t *labels, int layers){
+        const int depth = (int)header.slabDepth;
+        const int numSlabs = voxRle::NumSlabs(layers, depth);
+        std::vector<std::string> coded(numSlabs);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+        for (int s = 0; s < numSlabs; ++s) {
+            const int z0 = s * depth;
+            const int count = std::min(depth, layers - z0);
+            voxRle::EncodeSlab(labels + (size_t)z0 * LayerVoxels(), header.dim[0], header.dim[1], count, coded[s]);
+        }
+        for (const std::string &slab : coded) {
+            file.write(slab.data(), slab.size());
+            index.push_back(index.back() + slab.size());
+        }
+        layersWritten += layers;
+    }
+
+public:
+    template<typename Grid>
+    voxRleWriter(const std::string &outputfile, const Grid &grid, int slabDepth = voxRle::defaultSlabDepth)
+        : outputfile(outputfile) {
+        if (slabDepth <= 0) throw std::runtime_error("Invalid RLE slab depth");
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "STL2VRLE", 8);
+        header.version = voxRle::version;
+        header.slabDepth = (uint32_t)slabDepth;
+        for (int k = 0; k < 3; ++k) {
+            header.dim[k] = grid.dim[k];
+            header.origin[k] = grid.origin[k];
+            header.spacing[k] = grid.spacing[k];
+        }
+        header.numSlabs = (uint32_t)voxRle::NumSlabs(grid.dim[2], slabDepth);
+
+        file.open(outputfile, std::ios::out | std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error("Failed to open file: " + outputfile);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        index.push_back(sizeof(header));
+    }
+
+    // Appends `layers` layers; extract(z0, z1, out) writes the int8 labels of
+    // layers [z0, z1) of the piece to out.
+    template<typename Extract>
+    void append(int layers, Extract &&extract){
+        const int depth = (int)header.slabDepth;
+        const size_t layerVoxels = LayerVoxels();
+        int z = 0;
+        if (pendingLayers > 0) {
+            const int take = std::min(layers, depth - pendingLayers);
+            pending.resize((size_t)depth * layerVoxels);
+            extract(0, take, pending.data() + (size_t)pendingLayers * layerVoxels);
+            pendingLayers += take;
+            z = take;
+            if (pendingLayers == depth) {
+                WriteSlabs(pending.data(), depth);
+                pendingLayers = 0;
+            }
+        }
+
+        // Whole slabs, a batch of about 64 MiB of labels at a time.
+        const int batchSlabs = (int)std::max<size_t>(1, (size_t(64) << 20) / std::max<size_t>(1, depth * layerVoxels));
+        std::vector<int8_t> labels;
+        while (layers - z >= depth) {
+            const int count = std::min(batchSlabs, (layers - z) / depth) * depth;
+            labels.resize((size_t)count * layerVoxels);
+            extract(z, z + count, labels.data());
+            WriteSlabs(labels.data(), count);
+            z += count;
+        }
+
+        if (z < layers) {
+            pending.resize((size_t)depth * layerVoxels);
+            extract(z, layers, pending.data());
+            pendingLayers = layers - z;
+        }
+    }
+
+    void close(){
+        if (pendingLayers > 0) WriteSlabs(pending.data(), pendingLayers);
+        pendingLayers = 0;
+        if (layersWritten != header.dim[2]) {
+            throw std::runtime_error("RLE file " + outputfile + " got " + std::to_string(layersWritten) + " of " +
+                                     std::to_string(header.dim[2]) + " layers");
+        }
+        header.indexOffset = index.back();
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint64_t));
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.close();
+        if (file.fail()) throw std::runtime_error("Failed to write file: " + outputfile);
+    }
+};
+
+// Random access to a .vrle file through a memory map.
+class voxRleReader
+{
+private:
+    mappedFile file;
+    voxRle::Header header;
+    std::vector<uint64_t> index;
+
+    void CheckBox(const int lo[3], const int hi[3]) const {
+        for (int k = 0; k < 3; ++k) {
+            if (lo[k] < 0 || hi[k] > header.dim[k] || lo[k] >= hi[k]) {
+                throw std::runtime_error("Box is empty or outside the grid");
+            }
+        }
+    }
+
+    int SlabLayers(int s) const {
+        return std::min((int)header.slabDepth, header.dim[2] - s * (int)header.slabDepth);
+    }
+
+    // Decodes the slabs overlapping layers [z0, z1) in parallel; row(y, z,
+    // runs, count) gets absolute coordinates.
+    template<typename Row>
+    void DecodeLayers(int z0, int z1, Row &&row) const {
+        const int depth = (int)header.slabDepth;
+        const int s0 = z0 / depth, s1 = (z1 - 1) / depth;
+        bool corrupt = false;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(||:corrupt)
+#endif
+        for (int s = s0; s <= s1; ++s) {
+            try {
+                voxRle::DecodeSlab(file.data() + index[s], file.data() + index[s + 1], header.dim[0], header.dim[1],
+                                   SlabLayers(s), [&](int y, int z, const std::pair<int8_t, int> *runs, size_t count) {
+                    const int gz = s * depth + z;
+                    if (gz >= z0 && gz < z1) row(y, gz, runs, count);
+                });
+            } catch (const std::exception&) {
+                corrupt = true;
+            }
+        }
+        if (corrupt) voxRle::Corrupt();
+    }
+
+public:
+    explicit voxRleReader(const std::string &path) : file(path) {
+        if (file.size() < sizeof(header)) voxRle::Corrupt();
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "STL2VRLE", 8) != 0) {
+            throw std::runtime_error("Not an RLE voxel file: " + path);
+        }
+        if (header.version != voxRle::version) {
+            throw std::runtime_error("Unsupported RLE voxel file version " + std::to_string(header.version));
+        }
+        if (header.dim[0] <= 0 || header.dim[1] <= 0 || header.dim[2] <= 0 || header.slabDepth == 0 ||
+            header.numSlabs != (uint32_t)voxRle::NumSlabs(header.dim[2], (int)header.slabDepth) ||
+            header.indexOffset + (header.numSlabs + 1) * sizeof(uint64_t) != file.size()) {
+            voxRle::Corrupt();
+        }
+        index.resize(header.numSlabs + 1);
+        std::memcpy(index.data(), file.data() + header.indexOffset, index.size() * sizeof(uint64_t));
+        for (uint32_t s = 0; s < header.numSlabs; ++s) {
+            if (index[s] > index[s + 1]) voxRle::Corrupt();
+        }
+        if (index[0] != sizeof(header) || index[header.numSlabs] != header.indexOffset) voxRle::Corrupt();
+    }
+
+    const int* dim() const { return header.dim; }
+    const double* origin() const { return header.origin; }
+    const double* spacing() const { return header.spacing; }
+
+    // Decodes the whole file into grid.
+    void readGrid(voxGrid &grid) const {
+        const int lo[3] = { 0, 0, 0 };
+        readGrid(grid, lo, header.dim);
+    }
+
+    // Decodes voxels lo <= (x, y, z) < hi into grid, whose origin is moved to
+    // voxel lo. Only the slabs overlapping [lo[2], hi[2]) are decoded.
+    void readGrid(voxGrid &grid, const int lo[3], const int hi[3]) const {
+        CheckBox(lo, hi);
+        for (int k = 0; k < 3; ++k) {
+            grid.dim[k] = hi[k] - lo[k];
+            grid.origin[k] = header.origin[k] + lo[k] * header.spacing[k];
+            grid.spacing[k] = header.spacing[k];
+        }
+        grid.allocate();
+        DecodeLayers(lo[2], hi[2], [&](int y, int z, const std::pair<int8_t, int> *runs, size_t count) {
+            if (y < lo[1] || y >= hi[1]) return;
+            uint64_t *surface = grid.surfaceRow(y - lo[1], z - lo[2]);
+            uint64_t *outside = grid.outsideRow(y - lo[1], z - lo[2]);
+            int x = 0;
+            for (size_t i = 0; i < count && x < hi[0]; ++i) {
+                const int end = x + runs[i].second;
+                const int a = std::max(x, lo[0]), b = std::min(end, hi[0]);
+                if (a < b && runs[i].first != 1) bitRow::SetRange(runs[i].first == 0 ? surface : outside, a - lo[0], b - lo[0]);
+                x = end;
+            }
+        });
+    }
+
+    // Decodes voxels lo <= (x, y, z) < hi as int8 labels, X fastest, into out,
+    // which holds (hi - lo) voxels per axis. Only the slabs overlapping
+    // [lo[2], hi[2]) are decoded.
+    void readBox(const int lo[3], const int hi[3], int8_t *out) const {
+        CheckBox(lo, hi);
+        const size_t sx = (size_t)(hi[0] - lo[0]), sy = (size_t)(hi[1] - lo[1]);
+        DecodeLayers(lo[2], hi[2], [&](int y, int z, const std::pair<int8_t, int> *runs, size_t count) {
+            if (y < lo[1] || y >= hi[1]) return;
+            int8_t *dst = out + ((size_t)(z - lo[2]) * sy + (y - lo[1])) * sx;
+            int x = 0;
+            for (size_t i = 0; i < count && x < hi[0]; ++i) {
+                const int end = x + runs[i].second;
+                const int a = std::max(x, lo[0]), b = std::min(end, hi[0]);
+                if (a < b) std::memset(dst + (a - lo[0]), runs[i].first, b - a);
+                x = end;
+            }
+        });
+    }
+};
+
+#endif
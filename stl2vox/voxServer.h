@@ -0,0 +1,687 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXSERVER_H__
+#define __VOXSERVER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define STL2VOX_HAS_SOCKETS 1
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stlReader.h"
+#include "stl2vox.h"
+#include "voxBatch.h"
+#include "voxWriter.h"
+#include "voxOptions.h"
+#include "voxHash.h"
+#include "threadPool.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Resident conversion service on a Unix domain socket. Clients skip process
+// and OpenMP start-up, and meshes they convert again are not parsed again.
+// A connection carries any number of requests, one per line, each answered
+// by one line:
+//
+//   PING                   OK
+//   STATS                  OK requests=.. busy=.. errors=.. pending=.. mesh_hits=.. ...
+//   SHUTDOWN               OK; the server stops once running requests are answered
+//   CONVERT key=value ...  OK ... | BUSY ... | ERROR message
+//
+// CONVERT keys (values are %XX-escaped, so paths may contain spaces):
+//   input=PATH     STL file to convert
+//   bytes=N        or: the STL file follows the request line as N raw bytes
+//   output=PATH    write the result to PATH
+//   output=shm     or: return it in a new POSIX shared memory object
+//   dim=X,Y,Z      grid size, required
+//   format, fill, raster, precision, levels, sdf, sparse, stream, stream-depth
+//                  as on the command line (0/1 for the flags); anything not
+//                  given comes from the server's own options
+//
+// A file reply is "OK output=PATH seconds=S mesh=hit|miss". A shm reply is
+//   OK shm=NAME bytes=B dim=X,Y,Z origin=X,Y,Z spacing=X,Y,Z labels=0 [distance=D] seconds=S mesh=..
+// where the object holds one int8 label per voxel (-1, 0, 1 as in the VTK
+// output, X fastest) and, with sdf, float32 distances from byte D. The
+// client owns the object and must shm_unlink it.
+//
+// At most limits.jobs requests are converted at once, each with an equal
+// share of the OpenMP threads, and up to limits.queue more wait for a slot.
+// Beyond that a request is answered BUSY straight away so the client can
+// retry later or elsewhere.
+class voxServer
+{
+public:
+    struct Limits {
+        int jobs = 1;                                   // requests converted at once
+        int queue = 16;                                 // requests waiting for a slot
+        uint64_t meshCacheBytes = uint64_t(1) << 30;    // parsed meshes kept for reuse
+        uint64_t maxInlineBytes = uint64_t(1) << 30;    // largest bytes=N accepted
+    };
+
+private:
+    struct LoadedMesh {
+        STLMesh stl;
+        IndexedMesh indexed;
+        size_t bytes = 0;
+    };
+
+    // Parsed meshes keyed by file identity or payload hash; the least
+    // recently used go first once maxBytes is exceeded.
+    class meshCache
+    {
+    private:
+        typedef std::pair<std::string, std::shared_ptr<const LoadedMesh>> Entry;
+        std::list<Entry> entries;   // most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        uint64_t maxBytes;
+        uint64_t bytes = 0;
+        std::mutex mutex;
+
+    public:
+        explicit meshCache(uint64_t maxBytes) : maxBytes(maxBytes) {}
+
+        std::shared_ptr<const LoadedMesh> find(const std::string &key){
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it == index.end()) return nullptr;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+
+        void insert(const std::string &key, const std::shared_ptr<const LoadedMesh> &mesh){
+            std::lock_guard<std::mutex> lock(mutex);
+            if (mesh->bytes > maxBytes || index.count(key)) return;
+            entries.emplace_front(key, mesh);
+            index[key] = entries.begin();
+            bytes += mesh->bytes;
+            while (bytes > maxBytes) {
+                bytes -= entries.back().second->bytes;
+                index.erase(entries.back().first);
+                entries.pop_back();
+            }
+        }
+
+        void report(std::ostream &out){
+            std::lock_guard<std::mutex> lock(mutex);
+            out << " meshes=" << entries.size() << " mesh_bytes=" << bytes;
+        }
+    };
+
+#ifdef STL2VOX_HAS_SOCKETS
+    // Buffered reads of request lines and inline payloads from a socket.
+    class lineReader
+    {
+    private:
+        int fd;
+        std::string buffer;
+        size_t start = 0;
+
+        bool Fill(){
+            if (start > 0) {
+                buffer.erase(0, start);
+                start = 0;
+            }
+            char chunk[65536];
+            ssize_t n;
+            do {
+                n = ::recv(fd, chunk, sizeof(chunk), 0);
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) return false;
+            buffer.append(chunk, (size_t)n);
+            return true;
+        }
+
+    public:
+        static const size_t maxLine = 65536;
+
+        explicit lineReader(int fd) : fd(fd) {}
+
+        // False at the end of the stream or on a line longer than maxLine.
+        bool readLine(std::string &line){
+            while (true) {
+                const size_t end = buffer.find('\n', start);
+                if (end != std::string::npos) {
+                    line.assign(buffer, start, end - start);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    start = end + 1;
+                    return true;
+                }
+                if (buffer.size() - start > maxLine || !Fill()) return false;
+            }
+        }
+
+        bool readBytes(size_t count, std::string &out){
+            while (buffer.size() - start < count) {
+                if (!Fill()) return false;
+            }
+            out.assign(buffer, start, count);
+            start += count;
+            return true;
+        }
+    };
+#endif
+
+    std::string socketPath;
+    voxOptions defaults;
+    Limits limits;
+    int threadsPerJob;
+    meshCache meshes;
+    threadPool pool;
+
+    std::atomic<bool> stopping{false};
+    std::mutex mutex;
+    std::condition_variable connectionsDone;
+    std::set<int> clients;
+    size_t connections = 0;
+    int pending = 0;                        // admitted requests not yet answered
+    std::atomic<uint64_t> requests{0}, busy{0}, errors{0}, meshHits{0}, meshMisses{0}, shmCount{0};
+
+    static void SetThreads(int numThreads){
+#ifdef _OPENMP
+        omp_set_num_threads(std::max(1, numThreads));
+#else
+        (void)numThreads;
+#endif
+    }
+
+    static int HardwareThreads(){
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+
+    static std::string Decode(const std::string &text){
+        std::string out;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '%' && i + 2 < text.size() && std::isxdigit((unsigned char)text[i + 1]) &&
+                std::isxdigit((unsigned char)text[i + 2])) {
+                out += (char)std::stoi(text.substr(i + 1, 2), nullptr, 16);
+                i += 2;
+            } else {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+
+    static std::string Join(const double v[3]){
+        std::ostringstream out;
+        out << std::setprecision(17) << v[0] << "," << v[1] << "," << v[2];
+        return out.str();
+    }
+
+    static void ParseDim(const std::string &text, int dim[3]){
+        char extra;
+        if (std::sscanf(text.c_str(), "%d,%d,%d%c", &dim[0], &dim[1], &dim[2], &extra) != 3 ||
+            dim[0] <= 0 || dim[1] <= 0 || dim[2] <= 0) {
+            throw std::runtime_error("Invalid dim: " + text);
+        }
+    }
+
+    static int ParseInt(const std::string &key, const std::string &text, int minimum){
+        char *end = nullptr;
+        const long value = std::strtol(text.c_str(), &end, 10);
+        if (end == text.c_str() || *end != '\0' || value < minimum || value > 1 << 30) {
+            throw std::runtime_error("Invalid " + key + ": " + text);
+        }
+        return (int)value;
+    }
+
+    // Request options on top of the server's.
+    voxOptions RequestOptions(const std::map<std::string, std::string> &params) const {
+        voxOptions options = defaults;
+        options.verbose = false;
+        options.stats = nullptr;
+        options.dim[0] = options.dim[1] = options.dim[2] = 0;
+        for (const auto &param : params) {
+            const std::string &key = param.first, &value = param.second;
+            if (key == "dim") ParseDim(value, options.dim);
+            else if (key == "format") options.format = voxOptions::ParseFormat(value);
+            else if (key == "fill") options.fill = voxOptions::ParseFill(value);
+            else if (key == "raster") options.raster = voxOptions::ParseRaster(value);
+            else if (key == "precision") options.precision = voxOptions::ParsePrecision(value);
+            else if (key == "levels") options.levels = ParseInt(key, value, 1);
+            else if (key == "sdf") options.sdfBand = ParseInt(key, value, 0);
+            else if (key == "sparse") options.sparse = ParseInt(key, value, 0) != 0;
+            else if (key == "stream") options.stream = ParseInt(key, value, 0) != 0;
+            else if (key == "stream-depth") options.streamDepth = ParseInt(key, value, 0);
+            else if (key != "input" && key != "bytes" && key != "output") {
+                throw std::runtime_error("Unknown key: " + key);
+            }
+        }
+        if (options.dim[0] <= 0) throw std::runtime_error("dim is required");
+        if (options.levels > 16) throw std::runtime_error("At most 16 levels are supported");
+        return options;
+    }
+
+    // Identity of a mesh source: the payload hash for inline bytes, the path,
+    // size and modification time for a file.
+    static std::string MeshKey(const std::string &input, const std::string &payload){
+        std::ostringstream key;
+        if (!input.empty()) {
+            const auto time = std::filesystem::last_write_time(input).time_since_epoch().count();
+            key << "file:" << std::filesystem::absolute(input).string() << ":"
+                << std::filesystem::file_size(input) << ":" << time;
+        } else {
+            key << "bytes:" << std::hex << stlReader::PayloadHash(payload.data(), payload.size())
+                << ":" << std::dec << payload.size();
+        }
+        return key.str();
+    }
+
+    std::shared_ptr<const LoadedMesh> LoadMesh(const std::string &input, const std::string &payload, bool &hit){
+        const std::string key = MeshKey(input, payload);
+        std::shared_ptr<const LoadedMesh> cached = meshes.find(key);
+        hit = cached != nullptr;
+        if (hit) {
+            ++meshHits;
+            return cached;
+        }
+
+        ++meshMisses;
+        std::shared_ptr<LoadedMesh> mesh = std::make_shared<LoadedMesh>();
+        if (defaults.indexed) {
+            if (input.empty()) stlReader::ReadStlBuffer(payload.data(), payload.size(), mesh->indexed);
+            else stlReader::ReadStlFile(input, mesh->indexed, false);
+            mesh->bytes = mesh->indexed.memoryBytes();
+        } else {
+            if (input.empty()) stlReader::ReadStlBuffer(payload.data(), payload.size(), mesh->stl);
+            else stlReader::ReadStlFile(input, mesh->stl, false);
+            mesh->bytes = mesh->stl.triangleList.size() * sizeof(Triangle);
+        }
+        meshes.insert(key, mesh);
+        return mesh;
+    }
+
+#ifdef STL2VOX_HAS_SOCKETS
+    // Converts into a new shared memory object, see the reply format above.
+    template<typename Mesh>
+    std::string ConvertToShm(const Mesh &mesh, const voxOptions &options){
+        voxGrid grid;
+        voxField distance;
+        voxBatch::CheckOptions(options);
+        stl2vox::Convert(mesh, grid, options);
+        if (options.sdfBand > 0) stl2vox::DistanceStage(mesh, grid, options, distance);
+        stl2vox::MorphologyStage(grid, options);
+
+        const size_t numVoxels = grid.numVoxels();
+        const size_t distanceOffset = (numVoxels + 7) & ~size_t(7);
+        const size_t bytes = options.sdfBand > 0 ? distanceOffset + numVoxels * sizeof(float) : numVoxels;
+        const std::string name = "/stl2vox-" + std::to_string((long long)getpid()) + "-" + std::to_string(++shmCount);
+
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) throw std::runtime_error("shm_open failed: " + std::string(std::strerror(errno)));
+        void *data = MAP_FAILED;
+        if (ftruncate(fd, (off_t)bytes) == 0) {
+            data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            throw std::runtime_error("Failed to map shared memory " + name);
+        }
+        voxWriter::ExtractLabels(grid, 0, grid.dim[2], static_cast<int8_t*>(data));
+        if (options.sdfBand > 0) {
+            std::memcpy(static_cast<char*>(data) + distanceOffset, distance.values.data(), numVoxels * sizeof(float));
+        }
+        munmap(data, bytes);
+
+        std::ostringstream reply;
+        reply << "OK shm=" << name << " bytes=" << bytes << " dim=" << grid.dim[0] << "," << grid.dim[1] << ","
+              << grid.dim[2] << " origin=" << Join(grid.origin) << " spacing=" << Join(grid.spacing) << " labels=0";
+        if (options.sdfBand > 0) reply << " distance=" << distanceOffset;
+        return reply.str();
+    }
+
+    template<typename Mesh>
+    std::string ConvertMesh(const Mesh &mesh, const std::string &output, const voxOptions &options){
+        if (output == "shm") return ConvertToShm(mesh, options);
+        voxBatch::ConvertMesh(mesh, output, options);
+        return "OK output=" + Encode(output);
+    }
+
+    std::string RunJob(const std::string &input, const std::string &payload, const std::string &output,
+                       const voxOptions &options){
+        SetThreads(threadsPerJob);
+        const auto start = std::chrono::steady_clock::now();
+        bool hit = false;
+        std::shared_ptr<const LoadedMesh> mesh = LoadMesh(input, payload, hit);
+        std::string reply = defaults.indexed ? ConvertMesh(mesh->indexed, output, options)
+                                             : ConvertMesh(mesh->stl, output, options);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return reply + " seconds=" + std::to_string(seconds) + " mesh=" + (hit ? "hit" : "miss");
+    }
+
+    // Strictly decimal, as strtoull alone also takes signs, spaces and trailing text.
+    static bool ParseCount(const std::string &text, uint64_t &count){
+        if (text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos) return false;
+        count = std::strtoull(text.c_str(), nullptr, 10);
+        return true;
+    }
+
+    std::string Convert(const std::string &arguments, lineReader &reader, bool &closeConnection){
+        std::vector<std::string> words;
+        std::istringstream tokens(arguments);
+        std::string token;
+        while (tokens >> token) words.push_back(token);
+
+        // Inline bytes are read before the other keys are parsed, so the
+        // connection stays in step with the client. If they cannot be read,
+        // the connection is closed.
+        std::string payload;
+        for (const std::string &word : words) {
+            if (word.compare(0, 6, "bytes=") != 0) continue;
+            uint64_t count = 0;
+            if (!payload.empty() || !ParseCount(word.substr(6), count) || count == 0 || count > limits.maxInlineBytes) {
+                closeConnection = true;
+                throw std::runtime_error("Invalid inline size: " + word.substr(6));
+            }
+            if (!reader.readBytes((size_t)count, payload)) {
+                closeConnection = true;
+                throw std::runtime_error("Connection closed inside the inline mesh");
+            }
+        }
+
+        std::map<std::string, std::string> params;
+        for (const std::string &word : words) {
+            const size_t eq = word.find('=');
+            if (eq == std::string::npos) throw std::runtime_error("Expected key=value: " + word);
+            params[word.substr(0, eq)] = Decode(word.substr(eq + 1));
+        }
+
+        const std::string input = params.count("input") ? params["input"] : "";
+        const std::string output = params.count("output") ? params["output"] : "";
+        if (input.empty() == payload.empty()) throw std::runtime_error("Give exactly one of input and bytes");
+        if (output.empty()) throw std::runtime_error("output is required");
+        const voxOptions options = RequestOptions(params);
+        if (output == "shm" && (options.sparse || options.stream || options.levels > 1)) {
+            throw std::runtime_error("Shared memory output needs a single dense grid");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pending >= limits.jobs + limits.queue) {
+                ++busy;
+                return "BUSY pending=" + std::to_string(pending);
+            }
+            ++pending;
+        }
+
+        std::promise<std::string> reply;
+        std::future<std::string> result = reply.get_future();
+        pool.submit([&, input, output, options] {
+            std::string text;
+            try {
+                text = RunJob(input, payload, output, options);
+            } catch (const std::exception &e) {
+                ++errors;
+                text = std::string("ERROR ") + e.what();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --pending;
+            }
+            reply.set_value(text);
+        });
+        return result.get();
+    }
+
+    std::string Handle(const std::string &line, lineReader &reader, bool &closeConnection){
+        const size_t space = line.find(' ');
+        const std::string command = line.substr(0, space);
+        const std::string arguments = space == std::string::npos ? "" : line.substr(space + 1);
+        if (command == "PING") return "OK";
+        if (command == "SHUTDOWN") {
+            stop();
+            closeConnection = true;
+            return "OK";
+        }
+        if (command == "STATS") {
+            std::ostringstream out;
+            int waiting;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                waiting = pending;
+            }
+            out << "OK requests=" << requests << " busy=" << busy << " errors=" << errors << " pending=" << waiting
+                << " mesh_hits=" << meshHits << " mesh_misses=" << meshMisses;
+            meshes.report(out);
+            return out.str();
+        }
+        if (command == "CONVERT") {
+            ++requests;
+            try {
+                return Convert(arguments, reader, closeConnection);
+            } catch (const std::exception &e) {
+                ++errors;
+                return std::string("ERROR ") + e.what();
+            }
+        }
+        return "ERROR Unknown command: " + command;
+    }
+
+    static bool SendAll(int fd, const std::string &text){
+        size_t sent = 0;
+        while (sent < text.size()) {
+            const ssize_t n = ::send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    void Serve(int client){
+        lineReader reader(client);
+        std::string line;
+        while (reader.readLine(line)) {
+            if (line.empty()) continue;
+            bool closeConnection = false;
+            const std::string reply = Handle(line, reader, closeConnection);
+            if (!SendAll(client, reply + "\n") || closeConnection) break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(client);
+        ::close(client);
+        --connections;
+        connectionsDone.notify_all();
+    }
+
+    static sockaddr_un Address(const std::string &path){
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long: " + path);
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        return address;
+    }
+
+    static int Connect(const std::string &path){
+        const sockaddr_un address = Address(path);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+#endif
+
+public:
+    voxServer(const std::string &socketPath, const voxOptions &defaults, const Limits &limits)
+        : socketPath(socketPath), defaults(defaults), limits(limits),
+          threadsPerJob(std::max(1, HardwareThreads() / std::max(1, limits.jobs))),
+          meshes(limits.meshCacheBytes), pool(std::max(1, limits.jobs)) {
+        this->limits.jobs = std::max(1, limits.jobs);
+        this->limits.queue = std::max(0, limits.queue);
+    }
+
+    voxServer(const voxServer&) = delete;
+    voxServer& operator=(const voxServer&) = delete;
+
+    // %XX-escapes a request value.
+    static std::string Encode(const std::string &text){
+        static const char *hex = "0123456789ABCDEF";
+        std::string out;
+        for (unsigned char c : text) {
+            if (c <= ' ' || c == '%' || c >= 0x7f) {
+                out += '%';
+                out += hex[c >> 4];
+                out += hex[c & 15];
+            } else {
+                out += (char)c;
+            }
+        }
+        return out;
+    }
+
+    // Accepts connections until stop() is called, then waits for the open
+    // connections to finish their requests.
+    void run(){
+#ifndef STL2VOX_HAS_SOCKETS
+        throw std::runtime_error("The server needs Unix domain sockets");
+#else
+        const int existing = Connect(socketPath);
+        if (existing >= 0) {
+            ::close(existing);
+            throw std::runtime_error("A server is already listening on " + socketPath);
+        }
+        ::unlink(socketPath.c_str());
+
+        const sockaddr_un address = Address(socketPath);
+        const int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, 64) != 0) {
+            const std::string error = std::strerror(errno);
+            if (listenFd >= 0) ::close(listenFd);
+            throw std::runtime_error("Failed to listen on " + socketPath + ": " + error);
+        }
+
+        while (!stopping) {
+            pollfd entry = { listenFd, POLLIN, 0 };
+            if (::poll(&entry, 1, 200) <= 0) continue;
+            const int client = ::accept(listenFd, nullptr, nullptr);
+            if (client < 0) continue;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                clients.insert(client);
+                ++connections;
+            }
+            std::thread([this, client] { Serve(client); }).detach();
+        }
+
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+        std::unique_lock<std::mutex> lock(mutex);
+        for (int client : clients) ::shutdown(client, SHUT_RD);
+        connectionsDone.wait(lock, [&] { return connections == 0; });
+#endif
+    }
+
+    // Makes run() return; safe to call from a signal handler.
+    void stop(){
+        stopping = true;
+    }
+
+    // Sends one request line (and an inline payload) and returns the reply
+    // line, for clients of a running server.
+    static std::string Request(const std::string &socketPath, const std::string &line, const std::string &payload = ""){
+#ifndef STL2VOX_HAS_SOCKETS
+        (void)socketPath; (void)line; (void)payload;
+        throw std::runtime_error("The server needs Unix domain sockets");
+#else
+        const int fd = Connect(socketPath);
+        if (fd < 0) throw std::runtime_error("No server is listening on " + socketPath);
+        std::string reply;
+        lineReader reader(fd);
+        const bool ok = SendAll(fd, line + "\n") && SendAll(fd, payload) && reader.readLine(reply);
+        ::close(fd);
+        if (!ok) throw std::runtime_error("The server on " + socketPath + " closed the connection");
+        return reply;
+#endif
+    }
+
+    // The CONVERT request for input with the per-request options of options.
+    static std::string ConvertRequest(const std::string &input, const std::string &output, const voxOptions &options){
+        static const char *formats[] = { "vtk-ascii", "vtk", "vti", "vti-zlib", "rle" };
+        std::ostringstream line;
+        line << "CONVERT input=" << Encode(input) << " output=" << Encode(output)
+             << " dim=" << options.dim[0] << "," << options.dim[1] << "," << options.dim[2]
+             << " format=" << formats[(int)options.format]
+             << " fill=" << (options.fill == FillMode::Parity ? "parity" : "flood")
+             << " raster=" << (options.raster == RasterMode::Triangles ? "triangles" : "slabs")
+             << " precision=" << (options.precision == Precision::Float ? "float" : "double")
+             << " levels=" << options.levels << " sdf=" << options.sdfBand
+             << " sparse=" << (options.sparse ? 1 : 0) << " stream=" << (options.stream ? 1 : 0)
+             << " stream-depth=" << options.streamDepth;
+        return line.str();
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////////////    
+// Copyright (c) 2024 Hajer Zhang, IDEAS, DLUT.
+//  
+// Permission is hereby granted, free of charge, to any person obtaining a copy  of this 
+// software and associated documentation files (the "Software"), to deal in the Software 
+// without restriction, including without limitation the rights to use, copy, modify, 
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+// permit persons to whom the Software is furnished to do so, subject to the following 
+// conditions:  
+//  
+// The above copyright notice and this permission notice shall be included in all  
+// copies or substantial portions of the Software.  
+//  
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,  
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A  
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT  
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF  
+// CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  
+// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  
+//  
+// Author: Hajer Zhang 
+// Date: 2024-12-17 
+// Description: A voxelization library to process STL files into voxel grids, supporting 
+//              academic, commercial, and various other purposes. Contributions and 
+//              citations are welcome.  
+//////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VOXSTATS_H__
+#define __VOXSTATS_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Per-conversion measurements. Stages record into it only when a voxStats is
+// attached to voxOptions::stats, so a disabled run pays one null check per stage.
+struct voxStats
+{
+    std::string file;
+    std::vector<std::pair<std::string, double>> stageSeconds;
+
+    size_t triangles = 0;
+    size_t voxels = 0;
+    size_t triangleVoxelTests = 0;  // candidate voxels passed to the triangle/box test
+    size_t triangleVoxelHits = 0;   // candidates that overlapped their triangle
+    size_t surfaceVoxels = 0;
+    size_t fillRounds = 0;          // even/odd sweeps of the outside fill
+    size_t fillRowUpdates = 0;      // rows that gained outside voxels
+    size_t fillPushes = 0;          // brick worklist pushes of the sparse flood fill
+    size_t rayCrossings = 0;        // ray/triangle crossings of the parity fill
+    size_t openRays = 0;            // parity rays with an odd number of crossings
+    size_t distanceTests = 0;       // voxel/triangle distances evaluated in the SDF band
+    size_t sweepRounds = 0;         // rounds of eight fast sweeps extending the SDF
+    size_t peakMemoryBytes = 0;     // high-water mark of the process's resident set so far; in a
+                                    // batch it includes earlier and concurrent files
+    size_t cacheHits = 0;           // grids loaded from the result cache
+
+    // Optional progress report: (stage, done, total).
+    std::function<void(const std::string&, size_t, size_t)> progress;
+
+    static size_t PeakResidentBytes(){
+#if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return (size_t)usage.ru_maxrss;
+#else
+        return (size_t)usage.ru_maxrss * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    // Time of a stage that runs several times (e.g. once per slab) is summed.
+    void addStage(const std::string &name, double seconds){
+        auto it = std::find_if(stageSeconds.begin(), stageSeconds.end(),
+                               [&](const std::pair<std::string, double> &stage) { return stage.first == name; });
+        if(it == stageSeconds.end()) stageSeconds.emplace_back(name, seconds);
+        else it->second += seconds;
+        peakMemoryBytes = std::max(peakMemoryBytes, PeakResidentBytes());
+    }
+
+    double stageTime(const std::string &name) const {
+        double total = 0;
+        for(const auto &stage : stageSeconds){
+            if(stage.first == name) total += stage.second;
+        }
+        return total;
+    }
+
+    std::string toJson() const {
+        std::ostringstream out;
+        out << "{\"file\":\"" << Escape(file) << "\",\"stages\":{";
+        for(size_t i = 0; i < stageSeconds.size(); ++i){
+            out << (i ? "," : "") << "\"" << Escape(stageSeconds[i].first) << "\":" << stageSeconds[i].second;
+        }
+        out << "},\"triangles\":" << triangles
+            << ",\"voxels\":" << voxels
+            << ",\"triangle_voxel_tests\":" << triangleVoxelTests
+            << ",\"triangle_voxel_hits\":" << triangleVoxelHits
+            << ",\"surface_voxels\":" << surfaceVoxels
+            << ",\"fill_rounds\":" << fillRounds
+            << ",\"fill_row_updates\":" << fillRowUpdates
+            << ",\"fill_pushes\":" << fillPushes
+            << ",\"ray_crossings\":" << rayCrossings
+            << ",\"open_rays\":" << openRays
+            << ",\"distance_tests\":" << distanceTests
+            << ",\"sweep_rounds\":" << sweepRounds
+            << ",\"peak_memory_bytes\":" << peakMemoryBytes
+            << ",\"cache_hits\":" << cacheHits << "}";
+        return out.str();
+    }
+
+    static std::string csvHeader(){
+        return "file,cache_s,read_s,grid_s,surface_s,outside_s,distance_s,morph_s,components_s,pyramid_s,write_s,triangles,voxels,triangle_voxel_tests,"
+               "triangle_voxel_hits,surface_voxels,fill_rounds,fill_row_updates,fill_pushes,ray_crossings,open_rays,distance_tests,sweep_rounds,peak_memory_bytes,cache_hits";
+    }
+
+    std::string toCsv() const {
+        std::ostringstream out;
+        out << "\"" << file << "\"";
+        for(const char *stage : {"cache", "read", "grid", "surface", "outside", "distance", "morph", "components", "pyramid", "write"}) out << "," << stageTime(stage);
+        out << "," << triangles << "," << voxels << "," << triangleVoxelTests << "," << triangleVoxelHits
+            << "," << surfaceVoxels << "," << fillRounds << "," << fillRowUpdates << "," << fillPushes
+            << "," << rayCrossings << "," << openRays << "," << distanceTests << "," << sweepRounds << "," << peakMemoryBytes << "," << cacheHits;
+        return out.str();
+    }
+
+private:
+    static std::string Escape(const std::string &text){
+        std::string out;
+        for(char c : text){
+            if(c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+};
+
+// Records the monotonic time between construction and destruction as a stage.
+class voxTimer
+{
+private:
+    voxStats *stats;
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    voxTimer(voxStats *stats, const char *name) : stats(stats), name(name) {
+        if(stats) start = std::chrono::steady_clock::now();
+    }
+    ~voxTimer(){
+        if(stats) stats->addStage(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    voxTimer(const voxTimer&) = delete;
+    voxTimer& operator=(const voxTimer&) = delete;
+};
+
+#endif
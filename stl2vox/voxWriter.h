@@ -27,38 +27,537 @@
 #ifndef __VOXWRITER_H__
 #define __VOXWRITER_H__
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef STL2VOX_USE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "voxGrid.h"
+#include "sparseGrid.h"
+#include "voxOptions.h"
+#include "voxRle.h"
+#include "voxAssembly.h"
+#include "voxComponents.h"
+
+#include <memory>
+
 class voxWriter
 {
+    friend class voxSlabWriter;
+
+private:
+    // Z layers are converted and written in blocks of roughly this many bytes.
+    static const size_t blockBytes = size_t(4) << 20;
+
+    static int LayersPerBlock(const int dim[3]){
+        size_t layerBytes = std::max<size_t>(1, (size_t)dim[0] * dim[1]);
+        return (int)std::max<size_t>(1, blockBytes / layerBytes);
+    }
+
+    template<typename Grid>
+    static void WriteLegacyHeader(std::ofstream &file, const Grid &voxGrid, const char *encoding, const char *type,
+                                  const char *name = "cell_type"){
+        file << std::setprecision(17);
+        file << "# vtk DataFile Version 3.0\n";
+        file << "Voxel Grid\n";
+        file << encoding << "\n";
+        file << "DATASET STRUCTURED_POINTS\n";
+        file << "DIMENSIONS " << voxGrid.dim[0] + 1 << " " << voxGrid.dim[1] + 1 << " " << voxGrid.dim[2] + 1 << "\n";
+        file << "SPACING " << voxGrid.spacing[0] << " " << voxGrid.spacing[1] << " " << voxGrid.spacing[2] << "\n";
+        file << "ORIGIN " << voxGrid.origin[0] << " " << voxGrid.origin[1] << " " << voxGrid.origin[2] << "\n";
+        file << "CELL_DATA " << voxGrid.numVoxels() << "\n";
+        file << "SCALARS " << name << " " << type << "\n";
+        file << "LOOKUP_TABLE default\n";
+    }
+
+    // fieldOffset is the offset of the field's array in the appended data.
+    template<typename Grid>
+    static std::string VTIHeader(const Grid &voxGrid, bool compress, const voxField *field = nullptr,
+                                 uint64_t fieldOffset = 0, const char *type = "Int8", const char *name = "cell_type"){
+        const int *dim = voxGrid.dim;
+        std::ostringstream header;
+        header << std::setprecision(17);
+        header << "<?xml version=\"1.0\"?>\n";
+        header << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\"";
+        if (compress) header << " compressor=\"vtkZLibDataCompressor\"";
+        header << ">\n";
+        header << "  <ImageData WholeExtent=\"0 " << dim[0] << " 0 " << dim[1] << " 0 " << dim[2] << "\""
+               << " Origin=\"" << voxGrid.origin[0] << " " << voxGrid.origin[1] << " " << voxGrid.origin[2] << "\""
+               << " Spacing=\"" << voxGrid.spacing[0] << " " << voxGrid.spacing[1] << " " << voxGrid.spacing[2] << "\">\n";
+        header << "    <Piece Extent=\"0 " << dim[0] << " 0 " << dim[1] << " 0 " << dim[2] << "\">\n";
+        header << "      <CellData Scalars=\"" << name << "\">\n";
+        header << "        <DataArray type=\"" << type << "\" Name=\"" << name << "\" format=\"appended\" offset=\"0\"/>\n";
+        if (field) {
+            header << "        <DataArray type=\"Float32\" Name=\"" << field->name << "\" format=\"appended\" offset=\""
+                   << fieldOffset << "\"/>\n";
+        }
+        header << "      </CellData>\n";
+        header << "    </Piece>\n";
+        header << "  </ImageData>\n";
+        header << "  <AppendedData encoding=\"raw\">\n   _";
+        return header.str();
+    }
+
+    // Copies the field values of layers [z0, z1) as bytes, big-endian for legacy VTK.
+    static void ExtractField(const voxField &field, const int dim[3], int z0, int z1, bool bigEndian, char *out){
+        const size_t layerVoxels = (size_t)dim[0] * dim[1];
+        const float *src = field.values.data() + (size_t)z0 * layerVoxels;
+        const size_t count = layerVoxels * (z1 - z0);
+        std::memcpy(out, src, count * sizeof(float));
+        if (!bigEndian) return;
+        uint32_t *words = reinterpret_cast<uint32_t*>(out);
+        for (size_t i = 0; i < count; ++i) words[i] = __builtin_bswap32(words[i]);
+    }
+
+    template<typename Grid>
+    static void CheckField(const Grid &voxGrid, const voxField *field){
+        if (field && field->values.size() != voxGrid.numVoxels()) {
+            throw std::runtime_error("Field " + field->name + " does not match the grid size");
+        }
+    }
+
+#ifdef STL2VOX_USE_ZLIB
+    // An appended VTK array split into blocks of whole Z layers and zlib-
+    // compressed in parallel: the block table (count, block size, last block
+    // size, compressed sizes) followed by the compressed blocks.
+    struct CompressedArray {
+        std::vector<uint64_t> table;
+        std::vector<std::vector<Bytef>> blocks;
+
+        uint64_t bytes() const {
+            uint64_t total = table.size() * sizeof(uint64_t);
+            for (const auto &block : blocks) total += block.size();
+            return total;
+        }
+
+        void write(std::ofstream &file) const {
+            file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint64_t));
+            for (const auto &block : blocks) {
+                file.write(reinterpret_cast<const char*>(block.data()), block.size());
+            }
+        }
+    };
+
+    // extract(z0, z1, raw) fills raw with the bytes of layers [z0, z1).
+    template<typename Extract>
+    static void CompressLayers(const int dim[3], size_t voxelBytes, int level, Extract &&extract, CompressedArray &array){
+        const int layers = LayersPerBlock(dim);
+        const size_t layerBytes = (size_t)dim[0] * dim[1] * voxelBytes;
+        const uint64_t totalBytes = (uint64_t)layerBytes * dim[2];
+        // Every block but the last holds `layers` full Z layers.
+        const uint64_t blockSize = layerBytes * layers;
+        const uint64_t numBlocks = dim[2] == 0 ? 0 : (uint64_t)(dim[2] + layers - 1) / layers;
+        const uint64_t lastSize = totalBytes - (numBlocks ? (numBlocks - 1) * blockSize : 0);
+
+        array.blocks.assign(numBlocks, std::vector<Bytef>());
+        std::vector<int> status(numBlocks, Z_OK);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            // Blocks are compressed into scratch and kept at their compressed
+            // size, so the array never holds the raw size at once.
+            std::vector<char> raw(blockSize);
+            std::vector<Bytef> scratch(compressBound((uLong)blockSize));
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+            for (long long b = 0; b < (long long)numBlocks; ++b) {
+                const int z0 = (int)b * layers;
+                const int z1 = std::min(dim[2], z0 + layers);
+                const uLong rawSize = (uLong)(layerBytes * (z1 - z0));
+                extract(z0, z1, raw.data());
+
+                uLongf size = (uLongf)scratch.size();
+                status[b] = compress2(scratch.data(), &size, reinterpret_cast<const Bytef*>(raw.data()), rawSize, level);
+                array.blocks[b].assign(scratch.begin(), scratch.begin() + size);
+            }
+        }
+        for (int s : status) {
+            if (s != Z_OK) throw std::runtime_error("zlib compression failed");
+        }
+
+        array.table.clear();
+        array.table.push_back(numBlocks);
+        array.table.push_back(blockSize);
+        array.table.push_back(lastSize);
+        for (const auto &block : array.blocks) array.table.push_back(block.size());
+    }
+#endif
+
+    static void CheckStream(std::ofstream &file, const std::string &outputfile){
+        if (!file) {
+            throw std::runtime_error("Failed to write file: " + outputfile);
+        }
+    }
+
+    static const char* LegacyType(uint16_t) { return "unsigned_short"; }
+    static const char* LegacyType(uint32_t) { return "unsigned_int"; }
+    static const char* XMLType(uint16_t) { return "UInt16"; }
+    static const char* XMLType(uint32_t) { return "UInt32"; }
+    static uint16_t ByteSwap(uint16_t value) { return __builtin_bswap16(value); }
+    static uint32_t ByteSwap(uint32_t value) { return __builtin_bswap32(value); }
+
+    // Writes one unsigned Value per cell of grid, named name, where
+    // extract(z0, z1, out) fills layers [z0, z1) X fastest.
+    template<typename Value, typename Grid, typename Extract>
+    static void WriteCellFile(const std::string &outputfile, const Grid &grid, voxFormat format, const char *name,
+                              Extract &&extract){
+        if (format == voxFormat::Rle) throw std::runtime_error("RLE files hold -1/0/1 labels, write " + std::string(name) + "s as VTK or VTI");
+#ifndef STL2VOX_USE_ZLIB
+        if (format == voxFormat::VTIZlib) {
+            throw std::runtime_error("Compressed VTI output requires building with STL2VOX_USE_ZLIB");
+        }
+#endif
+        const bool ascii = format == voxFormat::VTKAscii;
+        std::ofstream file(outputfile, ascii ? std::ios::out : std::ios::out | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + outputfile);
+        }
+
+        const int layers = LayersPerBlock(grid.dim);
+        const size_t layerVoxels = (size_t)grid.dim[0] * grid.dim[1];
+        const uint64_t totalBytes = (uint64_t)grid.numVoxels() * sizeof(Value);
+        if (format == voxFormat::VTKAscii || format == voxFormat::VTKBinary || format == voxFormat::VTIRaw) {
+            if (ascii) WriteLegacyHeader(file, grid, "ASCII", LegacyType(Value()), name);
+            else if (format == voxFormat::VTKBinary) WriteLegacyHeader(file, grid, "BINARY", LegacyType(Value()), name);
+            else {
+                file << VTIHeader(grid, false, nullptr, 0, XMLType(Value()), name);
+                file.write(reinterpret_cast<const char*>(&totalBytes), sizeof(totalBytes));
+            }
+            std::vector<Value> values(layerVoxels * layers);
+            for (int z0 = 0; z0 < grid.dim[2]; z0 += layers) {
+                const int z1 = std::min(grid.dim[2], z0 + layers);
+                const size_t count = layerVoxels * (z1 - z0);
+                extract(z0, z1, values.data());
+                if (ascii) {
+                    for (size_t i = 0; i < count; ++i) file << values[i] << '\n';
+                    continue;
+                }
+                if (format == voxFormat::VTKBinary) {
+                    for (size_t i = 0; i < count; ++i) values[i] = ByteSwap(values[i]);
+                }
+                file.write(reinterpret_cast<const char*>(values.data()), count * sizeof(Value));
+            }
+            if (format == voxFormat::VTKBinary) file << "\n";
+        }
+#ifdef STL2VOX_USE_ZLIB
+        else {
+            CompressedArray values;
+            CompressLayers(grid.dim, sizeof(Value), 1, [&](int z0, int z1, char *raw) {
+                extract(z0, z1, reinterpret_cast<Value*>(raw));
+            }, values);
+            file << VTIHeader(grid, true, nullptr, 0, XMLType(Value()), name);
+            values.write(file);
+        }
+#endif
+        if (format == voxFormat::VTIRaw || format == voxFormat::VTIZlib) {
+            file << "\n  </AppendedData>\n";
+            file << "</VTKFile>\n";
+        }
+
+        CheckStream(file, outputfile);
+        file.close();
+    }
+
 public:
-    static void WriteVTKFile(const std::string outputfile, voxGrid &voxGrid){
+    // Writes the labels of layers [z0, z1) as one signed Label per voxel, X
+    // fastest. The files use int8_t.
+    template<typename Label>
+    static void ExtractLabels(const voxGrid &grid, int z0, int z1, Label *out){
+        const int numX = grid.dim[0];
+        const int numY = grid.dim[1];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(int z = z0; z < z1; ++z){
+            for(int y = 0; y < numY; ++y){
+                const uint64_t *surf = grid.surfaceRow(y, z);
+                const uint64_t *out_ = grid.outsideRow(y, z);
+                Label *dst = out + ((size_t)(z - z0) * numY + y) * numX;
+                for(int x = 0; x < numX; ++x){
+                    const uint64_t bit = uint64_t(1) << (x & 63);
+                    dst[x] = (surf[x >> 6] & bit) ? Label(0) : ((out_[x >> 6] & bit) ? Label(-1) : Label(1));
+                }
+            }
+        }
+    }
+
+    template<typename Grid, typename Label>
+    static void ExtractLabels(const Grid &grid, int z0, int z1, Label *out){
+        const int numX = grid.dim[0];
+        const int numY = grid.dim[1];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(int z = z0; z < z1; ++z){
+            for(int y = 0; y < numY; ++y){
+                Label *dst = out + ((size_t)(z - z0) * numY + y) * numX;
+                for(int x = 0; x < numX; ++x) dst[x] = grid.template get<Label>(x, y, z);
+            }
+        }
+    }
+
+    // field, when given, is written as a second cell array after the labels.
+    template<typename Grid>
+    static void WriteVTKFile(const std::string outputfile, Grid &voxGrid, const voxField *field = nullptr){
+        CheckField(voxGrid, field);
         std::ofstream file(outputfile);
         if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file");
-        }
-
-        int numVoxels = voxGrid.dim[0]*voxGrid.dim[1]*voxGrid.dim[2];
-        file << "# vtk DataFile Version 3.0" << std::endl;
-        file << "Voxel Grid" << std::endl;
-        file << "ASCII" << std::endl;
-        file << "DATASET STRUCTURED_POINTS" << std::endl;
-        file << "DIMENSIONS " << voxGrid.dim[0] + 1 << " " << voxGrid.dim[1] + 1 << " " << voxGrid.dim[2] + 1 << std::endl;
-        file << "SPACING " << voxGrid.spacing[0] << " " << voxGrid.spacing[1] << " " << voxGrid.spacing[2] << std::endl;
-        file << "ORIGIN " << voxGrid.origin[0] << " " << voxGrid.origin[1] << " " << voxGrid.origin[2] << std::endl;
-        file << "CELL_DATA " << numVoxels << std::endl;
-        file << "SCALARS cell_type double" << std::endl;
-        file << "LOOKUP_TABLE default" << std::endl;
-        for(int i = 0; i < numVoxels; i++)
+            throw std::runtime_error("Failed to open file: " + outputfile);
+        }
+
+        WriteLegacyHeader(file, voxGrid, "ASCII", "double");
+
+        const int layers = LayersPerBlock(voxGrid.dim);
+        const size_t layerVoxels = (size_t)voxGrid.dim[0] * voxGrid.dim[1];
+        std::vector<int8_t> labels(layerVoxels * layers);
+        for(int z0 = 0; z0 < voxGrid.dim[2]; z0 += layers)
+        {
+            const int z1 = std::min(voxGrid.dim[2], z0 + layers);
+            ExtractLabels(voxGrid, z0, z1, labels.data());
+            for(size_t i = 0; i < layerVoxels * (z1 - z0); i++)
+            {
+                file << (int)labels[i] << '\n';
+            }
+        }
+
+        if (field) {
+            file << "SCALARS " << field->name << " float\n";
+            file << "LOOKUP_TABLE default\n";
+            file << std::setprecision(9);
+            for (float value : field->values) file << value << '\n';
+        }
+
+        CheckStream(file, outputfile);
+        file.close();
+    }
+
+    // Legacy VTK with one signed byte per cell (-1, 0, 1), and the field as
+    // big-endian float32.
+    template<typename Grid>
+    static void WriteVTKBinaryFile(const std::string outputfile, Grid &voxGrid, const voxField *field = nullptr){
+        CheckField(voxGrid, field);
+        std::ofstream file(outputfile, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + outputfile);
+        }
+
+        WriteLegacyHeader(file, voxGrid, "BINARY", "signed_char");
+
+        const int layers = LayersPerBlock(voxGrid.dim);
+        const size_t layerVoxels = (size_t)voxGrid.dim[0] * voxGrid.dim[1];
+        std::vector<int8_t> labels(layerVoxels * layers);
+        for(int z0 = 0; z0 < voxGrid.dim[2]; z0 += layers)
         {
-            file << double(voxGrid.value[i]) << std::endl;
+            const int z1 = std::min(voxGrid.dim[2], z0 + layers);
+            ExtractLabels(voxGrid, z0, z1, labels.data());
+            file.write(reinterpret_cast<const char*>(labels.data()), layerVoxels * (z1 - z0));
+        }
+        file << "\n";
+
+        if (field) {
+            file << "SCALARS " << field->name << " float\n";
+            file << "LOOKUP_TABLE default\n";
+            std::vector<char> values(layerVoxels * layers * sizeof(float));
+            for (int z0 = 0; z0 < voxGrid.dim[2]; z0 += layers) {
+                const int z1 = std::min(voxGrid.dim[2], z0 + layers);
+                ExtractField(*field, voxGrid.dim, z0, z1, true, values.data());
+                file.write(values.data(), layerVoxels * (z1 - z0) * sizeof(float));
+            }
+            file << "\n";
+        }
+
+        CheckStream(file, outputfile);
+        file.close();
+    }
+
+    // XML ImageData with the labels as an Int8 appended array (and the field
+    // as Float32), either raw or split into blocks of whole Z layers that are
+    // zlib-compressed in parallel.
+    template<typename Grid>
+    static void WriteVTIFile(const std::string outputfile, Grid &voxGrid, bool compress, int level = 1,
+                             const voxField *field = nullptr){
+#ifndef STL2VOX_USE_ZLIB
+        if (compress) {
+            throw std::runtime_error("Compressed VTI output requires building with STL2VOX_USE_ZLIB");
+        }
+#endif
+        CheckField(voxGrid, field);
+        std::ofstream file(outputfile, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + outputfile);
+        }
+
+        const int *dim = voxGrid.dim;
+        const int layers = LayersPerBlock(dim);
+        const size_t layerVoxels = (size_t)dim[0] * dim[1];
+        const uint64_t totalBytes = (uint64_t)voxGrid.numVoxels();
+
+        if (!compress) {
+            file << VTIHeader(voxGrid, false, field, sizeof(uint64_t) + totalBytes);
+            std::vector<int8_t> labels(layerVoxels * layers);
+            file.write(reinterpret_cast<const char*>(&totalBytes), sizeof(totalBytes));
+            for (int z0 = 0; z0 < dim[2]; z0 += layers) {
+                const int z1 = std::min(dim[2], z0 + layers);
+                ExtractLabels(voxGrid, z0, z1, labels.data());
+                file.write(reinterpret_cast<const char*>(labels.data()), layerVoxels * (z1 - z0));
+            }
+            if (field) {
+                const uint64_t fieldBytes = totalBytes * sizeof(float);
+                file.write(reinterpret_cast<const char*>(&fieldBytes), sizeof(fieldBytes));
+                file.write(reinterpret_cast<const char*>(field->values.data()), fieldBytes);
+            }
+        }
+#ifdef STL2VOX_USE_ZLIB
+        else {
+            CompressedArray labels, values;
+            CompressLayers(dim, 1, level, [&](int z0, int z1, char *raw) {
+                ExtractLabels(voxGrid, z0, z1, reinterpret_cast<int8_t*>(raw));
+            }, labels);
+            if (field) {
+                CompressLayers(dim, sizeof(float), level, [&](int z0, int z1, char *raw) {
+                    ExtractField(*field, dim, z0, z1, false, raw);
+                }, values);
+            }
+            file << VTIHeader(voxGrid, true, field, labels.bytes());
+            labels.write(file);
+            if (field) values.write(file);
+        }
+#endif
+
+        file << "\n  </AppendedData>\n";
+        file << "</VTKFile>\n";
+
+        CheckStream(file, outputfile);
+        file.close();
+    }
+
+    // Run-length coded labels with a slab index, see voxRle.
+    template<typename Grid>
+    static void WriteRleFile(const std::string outputfile, Grid &voxGrid, const voxField *field = nullptr){
+        if (field) throw std::runtime_error("RLE files hold labels only, write the distances as VTK or VTI");
+        voxRleWriter writer(outputfile, voxGrid);
+        writer.append(voxGrid.dim[2], [&](int z0, int z1, int8_t *out) { ExtractLabels(voxGrid, z0, z1, out); });
+        writer.close();
+    }
+
+    template<typename Grid>
+    static void WriteFile(const std::string outputfile, Grid &voxGrid, voxFormat format, const voxField *field = nullptr){
+        switch (format) {
+            case voxFormat::VTKAscii:  WriteVTKFile(outputfile, voxGrid, field); break;
+            case voxFormat::VTKBinary: WriteVTKBinaryFile(outputfile, voxGrid, field); break;
+            case voxFormat::VTIRaw:    WriteVTIFile(outputfile, voxGrid, false, 1, field); break;
+            case voxFormat::VTIZlib:   WriteVTIFile(outputfile, voxGrid, true, 1, field); break;
+            case voxFormat::Rle:       WriteRleFile(outputfile, voxGrid, field); break;
+        }
+    }
+
+    // Material IDs of an assembly as an unsigned 16-bit "material" array, in
+    // the same layouts as the labels (big-endian for legacy VTK).
+    static void WriteMaterialFile(const std::string outputfile, const materialGrid &grid, voxFormat format){
+        const size_t layerVoxels = (size_t)grid.dim[0] * grid.dim[1];
+        WriteCellFile<uint16_t>(outputfile, grid, format, "material", [&](int z0, int z1, uint16_t *out) {
+            std::memcpy(out, grid.labels.data() + (size_t)z0 * layerVoxels, layerVoxels * (z1 - z0) * sizeof(uint16_t));
+        });
+    }
+
+    // Component IDs as UInt32 "component" cells, see voxComponents.
+    static void WriteComponentFile(const std::string outputfile, const voxComponents &components, voxFormat format){
+        WriteCellFile<uint32_t>(outputfile, components, format, "component", [&](int z0, int z1, uint32_t *out) {
+            components.extract(z0, z1, out);
+        });
+    }
+
+    static const char* Extension(voxFormat format){
+        if (format == voxFormat::Rle) return ".vrle";
+        return (format == voxFormat::VTIRaw || format == voxFormat::VTIZlib) ? ".vti" : ".vtk";
+    }
+};
+
+// Writes a grid one Z slab at a time, for grids that are never held in memory
+// as a whole (see stl2vox::StreamSlabs). Slabs must arrive in Z order. Zlib
+// VTI is not supported because its block table precedes the data.
+class voxSlabWriter
+{
+private:
+    std::ofstream file;
+    std::string outputfile;
+    voxFormat format;
+    std::vector<int8_t> labels;
+    std::unique_ptr<voxRleWriter> rle;
+
+public:
+    voxSlabWriter(const std::string &outputfile, const voxGrid &grid, voxFormat format)
+        : outputfile(outputfile), format(format) {
+        if (format == voxFormat::VTIZlib) {
+            throw std::runtime_error("Compressed VTI output is not supported when streaming");
+        }
+        if (format == voxFormat::Rle) {
+            rle.reset(new voxRleWriter(outputfile, grid));
+            return;
+        }
+        file.open(outputfile, format == voxFormat::VTKAscii ? std::ios::out : std::ios::out | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + outputfile);
+        }
+
+        if (format == voxFormat::VTKAscii) {
+            voxWriter::WriteLegacyHeader(file, grid, "ASCII", "double");
+        } else if (format == voxFormat::VTKBinary) {
+            voxWriter::WriteLegacyHeader(file, grid, "BINARY", "signed_char");
+        } else {
+            file << voxWriter::VTIHeader(grid, false);
+            const uint64_t totalBytes = (uint64_t)grid.numVoxels();
+            file.write(reinterpret_cast<const char*>(&totalBytes), sizeof(totalBytes));
         }
+    }
 
+    // Appends all layers of slab.
+    void write(const voxGrid &slab){
+        if (rle) {
+            rle->append(slab.dim[2], [&](int z0, int z1, int8_t *out) { voxWriter::ExtractLabels(slab, z0, z1, out); });
+            return;
+        }
+        const int layers = voxWriter::LayersPerBlock(slab.dim);
+        const size_t layerVoxels = (size_t)slab.dim[0] * slab.dim[1];
+        labels.resize(layerVoxels * layers);
+        for (int z0 = 0; z0 < slab.dim[2]; z0 += layers) {
+            const int z1 = std::min(slab.dim[2], z0 + layers);
+            voxWriter::ExtractLabels(slab, z0, z1, labels.data());
+            if (format == voxFormat::VTKAscii) {
+                for (size_t i = 0; i < layerVoxels * (z1 - z0); i++) file << (int)labels[i] << '\n';
+            } else {
+                file.write(reinterpret_cast<const char*>(labels.data()), layerVoxels * (z1 - z0));
+            }
+        }
+        voxWriter::CheckStream(file, outputfile);
+    }
+
+    void close(){
+        if (rle) {
+            rle->close();
+            return;
+        }
+        if (format == voxFormat::VTKBinary) file << "\n";
+        if (format == voxFormat::VTIRaw) file << "\n  </AppendedData>\n</VTKFile>\n";
+        voxWriter::CheckStream(file, outputfile);
         file.close();
     }
 };
 
-#endif
\ No newline at end of file
+#endif